@@ -0,0 +1,129 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "alloc-counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace apbench {
+namespace {
+
+/* Constant initialized, so the counters work before main and in every thread. */
+thread_local AllocCounts s_counts = { 0, 0, 0 };
+
+void countAlloc(size_t size)
+{
+    ++s_counts.allocs;
+    s_counts.bytes += size;
+}
+
+void countFree(void* ptr)
+{
+    if (ptr)
+        ++s_counts.frees;
+}
+
+} // namespace anonymous
+
+AllocCounts allocCounts()
+{
+    return s_counts;
+}
+
+AllocCounts allocCountsSince(const AllocCounts& begin)
+{
+    const AllocCounts counts = { s_counts.allocs - begin.allocs, s_counts.bytes - begin.bytes, s_counts.frees - begin.frees };
+    return counts;
+}
+
+} // namespace apbench
+
+#if defined(__GLIBC__)
+
+/* The parser grows its arrays with realloc, so the malloc family is replaced and operator
+ * new is counted through it. The glibc implementations stay reachable as __libc_*.
+ */
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    apbench::countAlloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    apbench::countAlloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    apbench::countAlloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    apbench::countFree(ptr);
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+#else // !defined(__GLIBC__)
+
+/* Without glibc only the allocations through operator new are counted. */
+
+void* operator new(size_t size)
+{
+    apbench::countAlloc(size);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    apbench::countFree(ptr);
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+#endif // defined(__GLIBC__)
@@ -0,0 +1,50 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Count the heap allocations of the current thread. Linking alloc-counter.cpp replaces the
+ * allocation functions of the program, so only the bench and test programs link it.
+ */
+
+#ifndef AP_ALLOC_COUNTER_H
+#define AP_ALLOC_COUNTER_H
+
+#include <cstddef>
+
+namespace apbench {
+
+struct AllocCounts {
+    size_t allocs; /*< Calls of malloc, calloc, realloc or operator new. */
+    size_t bytes; /*< Requested bytes of these calls. */
+    size_t frees;
+};
+
+/*! \brief Return the counts of the current thread since it started */
+AllocCounts allocCounts();
+
+/*! \brief Return the counts of the current thread since 'begin' */
+AllocCounts allocCountsSince(const AllocCounts& begin);
+
+} // namespace apbench
+
+#endif // AP_ALLOC_COUNTER_H
@@ -0,0 +1,266 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Report the heap allocations of every macro of a standard program, and check them against
+ * a budget.
+ *
+ * Usage: ap-alloc [options], see 'ap-alloc --help'.
+ *
+ * The standard program defines 10 flags of each value type, 20 arguments and a CHECK_FLAG.
+ * It runs with values ("parse") and with --help ("help"), and a program of 400 int flags,
+ * whose specs exceed the inline buffers of the parser, runs with values ("many"). Every
+ * workload runs twice: the first run starts
+ * with empty parser arrays ("cold"), the second one reuses them ("warm"). Every macro prints
+ * one CSV line to stdout, the budget violations go to stderr.
+ */
+
+#include "alloc-counter.h"
+#include "arg-parser.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum Macro { ParseHelp, ParseFlag, ParseArg, CheckFlag, FlushHelp, MacroCount };
+const char* const s_macroNames[MacroCount] = { "PARSE_HELP", "PARSE_FLAG", "PARSE_ARG", "CHECK_FLAG", "FLUSH_HELP" };
+
+struct MacroStats {
+    size_t calls;
+    size_t allocs;
+    size_t bytes;
+    size_t maxAllocs; /*< Most allocations of one call. */
+};
+
+struct Report {
+    std::string workload;
+    std::string phase;
+    MacroStats macros[MacroCount];
+};
+
+Report* s_report = nullptr;
+
+void count(Macro macro, const apbench::AllocCounts& begin)
+{
+    const apbench::AllocCounts counts = apbench::allocCountsSince(begin);
+    MacroStats& stats = s_report->macros[macro];
+    ++stats.calls;
+    stats.allocs += counts.allocs;
+    stats.bytes += counts.bytes;
+    if (counts.allocs > stats.maxAllocs)
+        stats.maxAllocs = counts.allocs;
+}
+
+/*! \brief Evaluate 'EXPR' of 'MACRO' and count its allocations, the value is not copied */
+#define COUNTED(MACRO, EXPR) [&]() { const apbench::AllocCounts begin = apbench::allocCounts(); auto&& value = EXPR; count(MACRO, begin); return value; }()
+
+size_t s_written = 0;
+
+void countBytes(void*, const char*, size_t size)
+{
+    s_written += size;
+}
+
+/*! \brief Specs of the flags of the standard program, made before the counted calls */
+struct Specs {
+    std::vector<std::string> ints, floats, strings, bools, chars, many;
+
+    Specs()
+    {
+        for (int i = 0; i < 400; ++i)
+            many.push_back("-m" + std::to_string(i) + ", --many-flag-" + std::to_string(i) + " INT");
+        for (int i = 0; i < 10; ++i) {
+            const std::string n = std::to_string(i);
+            ints.push_back("-i" + n + ", --int-" + n + " INT");
+            floats.push_back("-f" + n + ", --float-" + n + " FLOAT");
+            strings.push_back("-s" + n + ", --string-" + n + " STRING");
+            bools.push_back("-b" + n + ", --bool-" + n);
+            chars.push_back("-c" + n + ", --char-" + n + " CHAR");
+        }
+    }
+};
+
+/*! \brief The standard program, returns a checksum of the parsed values */
+unsigned long standardProgram(const Specs& specs, int argc, const char* const* argv)
+{
+    const std::string defaultString = "default";
+    unsigned long sum = COUNTED(ParseHelp, PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options] ARGS...\n\nOptions:", argc, argv));
+    for (size_t i = 0; i < 10; ++i) {
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.ints[i], 300, "set an int. Default is '%d'."));
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.floats[i], 0.5f, "set a float. Default is '%d'."));
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.strings[i], defaultString, "set a string. Default is '%d'.")).size();
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.bools[i], false, "set a bool."));
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.chars[i], 'c', "set a char. Default is '%d'."));
+    }
+    sum += COUNTED(CheckFlag, CHECK_FLAG("-v, --verbose", argc, argv));
+    COUNTED(FlushHelp, (FLUSH_HELP(), 0));
+    for (int i = 0; i < 20; ++i)
+        sum += COUNTED(ParseArg, PARSE_ARG(0));
+    return sum;
+}
+
+/*! \brief The program of many flags, returns a checksum of the parsed values */
+unsigned long manyProgram(const Specs& specs, int argc, const char* const* argv)
+{
+    unsigned long sum = COUNTED(ParseHelp, PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nOptions:", argc, argv));
+    for (size_t i = 0; i < specs.many.size(); ++i)
+        sum += COUNTED(ParseFlag, PARSE_FLAG(specs.many[i], 300, "set an int. Default is '%d'."));
+    COUNTED(FlushHelp, (FLUSH_HELP(), 0));
+    return sum;
+}
+
+std::vector<const char*> manyArgv(std::vector<std::string>& storage)
+{
+    storage.push_back("ap-alloc");
+    for (int i = 0; i < 400; i += 40) {
+        storage.push_back("--many-flag-" + std::to_string(i));
+        storage.push_back(std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for (size_t i = 0; i < storage.size(); ++i)
+        argv.push_back(storage[i].c_str());
+    return argv;
+}
+
+std::vector<const char*> parseArgv(std::vector<std::string>& storage)
+{
+    storage.push_back("ap-alloc");
+    for (int i = 0; i < 10; ++i) {
+        const std::string n = std::to_string(i);
+        storage.push_back("--int-" + n + "=" + n);
+        storage.push_back("-f" + n);
+        storage.push_back(n + ".25");
+        storage.push_back("--string-" + n);
+        storage.push_back(i % 2 ? "short" : "a value longer than the small string buffer");
+        storage.push_back("--bool-" + n);
+        storage.push_back("-c" + n);
+        storage.push_back("x");
+    }
+    storage.push_back("--verbose");
+    for (int i = 0; i < 20; ++i)
+        storage.push_back(std::to_string(i));
+    std::vector<const char*> argv;
+    for (size_t i = 0; i < storage.size(); ++i)
+        argv.push_back(storage[i].c_str());
+    return argv;
+}
+
+typedef unsigned long (*Program)(const Specs& specs, int argc, const char* const* argv);
+
+void run(std::vector<Report>& reports, const char* workload, const std::vector<const char*>& argv, Program program = standardProgram)
+{
+    const char* const phases[] = { "cold", "warm" };
+    const Specs specs;
+    for (size_t phase = 0; phase < 2; ++phase) {
+        Report report;
+        std::memset(report.macros, 0, sizeof(report.macros));
+        report.workload = workload;
+        report.phase = phases[phase];
+        s_report = &report;
+        program(specs, int(argv.size()), argv.data());
+        s_report = nullptr;
+        reports.push_back(report);
+    }
+}
+
+const MacroStats* findStats(const std::vector<Report>& reports, const std::string& workload, const std::string& phase, const std::string& macro)
+{
+    for (size_t i = 0; i < reports.size(); ++i)
+        for (size_t m = 0; m < MacroCount; ++m)
+            if (reports[i].workload == workload && reports[i].phase == phase && macro == s_macroNames[m])
+                return &reports[i].macros[m];
+    return nullptr;
+}
+
+/*! \brief Check the lines 'WORKLOAD PHASE MACRO MAX_ALLOCS_PER_CALL' of 'path', '#' starts a comment */
+bool checkBudget(const std::vector<Report>& reports, const std::string& path)
+{
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file) {
+        std::perror(path.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    char line[256];
+    for (int lineNumber = 1; std::fgets(line, sizeof(line), file); ++lineNumber) {
+        char workload[64], phase[64], macro[64];
+        size_t budget;
+        const char* data = line + std::strspn(line, " \t");
+        if (*data == '#' || *data == '\n' || !*data)
+            continue;
+        const MacroStats* stats = nullptr;
+        if (std::sscanf(data, "%63s %63s %63s %zu", workload, phase, macro, &budget) != 4 || !(stats = findStats(reports, workload, phase, macro))) {
+            std::fprintf(stderr, "%s:%d: invalid budget line: %s", path.c_str(), lineNumber, line);
+            ok = false;
+        } else if (stats->maxAllocs > budget) {
+            std::fprintf(stderr, "%s:%d: %s %s %s: %zu allocations in one call, the budget is %zu\n",
+                path.c_str(), lineNumber, workload, phase, macro, stats->maxAllocs, budget);
+            ok = false;
+        }
+    }
+    std::fclose(file);
+    return ok;
+}
+
+} // namespace anonymous
+
+int main(int argc, char* argv[])
+{
+    // Measure before the options are parsed, so the cold runs start with empty parser arrays.
+    const ap::Writer counter = { countBytes, nullptr };
+    const ap::Writer stdoutWriter = ap::s_stdout;
+    ap::s_stdout = counter;
+
+    std::vector<Report> reports;
+    std::vector<std::string> storage;
+    run(reports, "parse", parseArgv(storage));
+    const char* const helpArgv[] = { "ap-alloc", "--help" };
+    run(reports, "help", std::vector<const char*>(helpArgv, helpArgv + 2));
+    std::vector<std::string> manyStorage;
+    run(reports, "many", manyArgv(manyStorage), manyProgram);
+
+    ap::s_stdout = stdoutWriter;
+    const bool help = PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nReport the heap allocations of every macro of a standard program.\n\nOptions:", argc, argv);
+    const std::string budget = PARSE_FLAG("-b, --budget FILE", std::string(), "fail if a macro allocates more than FILE allows, see bench/alloc-budget.txt.");
+    const size_t unparsed = UNPARSED_COUNT();
+    if (help)
+        return 0;
+    if (unparsed) {
+        std::fprintf(stderr, "Unknown arguments, see '%s --help'.\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("workload,phase,macro,calls,allocs,bytes,max_allocs_per_call\n");
+    for (size_t i = 0; i < reports.size(); ++i)
+        for (size_t m = 0; m < MacroCount; ++m) {
+            const MacroStats& stats = reports[i].macros[m];
+            std::printf("%s,%s,%s,%zu,%zu,%zu,%zu\n", reports[i].workload.c_str(), reports[i].phase.c_str(), s_macroNames[m],
+                stats.calls, stats.allocs, stats.bytes, stats.maxAllocs);
+        }
+
+    return budget.empty() || checkBudget(reports, budget) ? 0 : 1;
+}
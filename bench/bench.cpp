@@ -0,0 +1,391 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measure the parse throughput and latency of the macro API on synthetic workloads.
+ *
+ * Usage: ap-bench [options], see 'ap-bench --help'.
+ *
+ * The workloads grow along the argv size (PARSE_ARG, CHECK_FLAG, bundled short flags, a value
+ * edited with PARSE_EDIT) and the number of defined flags (PARSE_FLAG with every value type, help
+ * page, completion query). Every workload prints one CSV line to stdout, the notes go to stderr.
+ * The allocations are counted by alloc-counter.cpp.
+ */
+
+#include "alloc-counter.h"
+#include "arg-parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif // defined(__linux__)
+
+namespace {
+
+struct Workload {
+    std::string name;
+    std::string type;
+    size_t flags;
+    std::vector<std::string> storage;
+    std::vector<const char*> argv;
+    std::vector<std::string> specs;
+    unsigned long (*run)(const Workload&);
+
+    int argc() const { return int(argv.size()); }
+    size_t tokens() const { return argv.size() - 1; }
+};
+
+struct Options {
+    int repeat;
+    int warmup;
+    double budget;
+};
+
+unsigned long checksum(int value) { return (unsigned long)value; }
+unsigned long checksum(float value) { return (unsigned long)value; }
+unsigned long checksum(bool value) { return value; }
+unsigned long checksum(const std::string& value) { return value.size(); }
+
+/* Workloads *****************************************************************/
+
+template<typename T>
+unsigned long runFlags(const Workload& w)
+{
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p", w.argc(), w.argv.data());
+    unsigned long sum = 0;
+    for (size_t i = 0; i < w.specs.size(); ++i)
+        sum += checksum(PARSE_FLAG(w.specs[i], T(), "set a flag. Default is '%d'."));
+    return sum;
+}
+
+unsigned long runArgs(const Workload& w)
+{
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p", w.argc(), w.argv.data());
+    unsigned long sum = 0;
+    for (size_t i = 0; i < w.tokens(); ++i)
+        sum += checksum(PARSE_ARG(0));
+    return sum + UNPARSED_COUNT();
+}
+
+/*! \brief Every single character flag is counted in the bundles, see makeShort() */
+unsigned long runShort(const Workload& w)
+{
+    ap::s_short_flag_prefixes = "-";
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p", w.argc(), w.argv.data());
+    unsigned long sum = 0;
+    for (size_t i = 0; i < w.specs.size(); ++i)
+        sum += COUNT_FLAG(w.specs[i], "count a flag.");
+    ap::s_short_flag_prefixes = "";
+    return sum + UNPARSED_COUNT();
+}
+
+unsigned long runCheck(const Workload& w)
+{
+    return CHECK_FLAG("-z, --absent", w.argc(), w.argv.data()) + CHECK_FLAG("-x, --last", w.argc(), w.argv.data());
+}
+
+size_t s_written = 0;
+
+void countBytes(void*, const char*, size_t size)
+{
+    s_written += size;
+}
+
+unsigned long runHelp(const Workload& w)
+{
+    s_written = 0;
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nOptions:", w.argc(), w.argv.data());
+    unsigned long sum = 0;
+    for (size_t i = 0; i < w.specs.size(); ++i)
+        sum += checksum(PARSE_FLAG(w.specs[i], int(i), "set flag. Default is '%d'."));
+    FLUSH_HELP();
+    return sum + s_written;
+}
+
+/*! \brief The answer is taken as a string, FLUSH_HELP() would print it and exit */
+unsigned long runComplete(const Workload& w)
+{
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nOptions:", w.argc(), w.argv.data());
+    unsigned long sum = 0;
+    for (size_t i = 0; i < w.specs.size(); ++i) {
+        sum += checksum(PARSE_FLAG(w.specs[i], int(i), "set flag. Default is '%d'."));
+        ADD_CHOICES(w.specs[i], "low, medium, high");
+    }
+    std::string page;
+    ap::take_help_page(page);
+    return sum + page.size();
+}
+
+/*! \brief Type into the value of '--mode' in the middle of the line, every run is a keystroke, see makeEdit() */
+unsigned long runEdit(const Workload& w)
+{
+    // The argv is edited in place like a line buffer, the words are kept in the specs.
+    std::vector<const char*>& argv = const_cast<Workload&>(w).argv;
+    const size_t value = w.tokens() / 2 + 1;
+    argv[value] = w.specs[argv[value] == w.specs[0].c_str()].c_str();
+    PARSE_EDIT("-h, --help", "show this help.", "Usage: %p [options] files", w.argc(), argv.data(), value, 1);
+    unsigned long sum = checksum(PARSE_FLAG("-m, --mode MODE", std::string(), "set the mode."));
+    sum += checksum(PARSE_FLAG("-v, --verbose", false, "print more."));
+    sum += checksum(PARSE_FLAG("-l, --level LEVEL", 1, "set the level. Default is '%d'."));
+    return sum + UNPARSED_COUNT();
+}
+
+/* Generators ****************************************************************/
+
+Workload makeWorkload(const char* name, const char* type, unsigned long (*run)(const Workload&))
+{
+    Workload w;
+    w.name = name;
+    w.type = type;
+    w.flags = 0;
+    w.run = run;
+    w.storage.push_back("ap-bench");
+    return w;
+}
+
+void finishArgv(Workload& w)
+{
+    w.argv.reserve(w.storage.size());
+    for (size_t i = 0; i < w.storage.size(); ++i)
+        w.argv.push_back(w.storage[i].c_str());
+}
+
+/*! \brief Flags are given in a shuffled order, with a value unless the type is bool */
+template<typename T>
+Workload makeFlags(const char* type, size_t count)
+{
+    const bool hasValue = std::string(type) != "bool";
+    Workload w = makeWorkload("flag", type, runFlags<T>);
+    w.flags = count;
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        w.specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i) + (hasValue ? " VALUE" : ""));
+        order[i] = i;
+    }
+    unsigned long random = 12345;
+    for (size_t i = count; i > 1; --i) {
+        random = random * 6364136223846793005ul + 1442695040888963407ul;
+        std::swap(order[i - 1], order[(random >> 33) % i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        w.storage.push_back("--flag-" + std::to_string(order[i]));
+        if (hasValue)
+            w.storage.push_back(type == std::string("std::string") ? "value-" + std::to_string(order[i]) : std::to_string(order[i]) + (type == std::string("float") ? ".5" : ""));
+    }
+    finishArgv(w);
+    return w;
+}
+
+Workload makeArgs(size_t count)
+{
+    Workload w = makeWorkload("arg", "int", runArgs);
+    for (size_t i = 0; i < count; ++i)
+        w.storage.push_back(std::to_string(i));
+    finishArgv(w);
+    return w;
+}
+
+/*! \brief Bundles of 8 short flags like '-abcdefgh', cycling through the 52 letters */
+Workload makeShort(size_t count)
+{
+    const std::string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    Workload w = makeWorkload("short", "bool", runShort);
+    w.flags = letters.size();
+    for (size_t i = 0; i < letters.size(); ++i)
+        w.specs.push_back(std::string("-") + letters[i]);
+    for (size_t i = 0; i < count; ++i) {
+        std::string bundle = "-";
+        for (size_t j = 0; j < 8; ++j)
+            bundle += letters[(8 * i + j) % letters.size()];
+        w.storage.push_back(bundle);
+    }
+    finishArgv(w);
+    return w;
+}
+
+/*! \brief Positional arguments around '--mode VALUE', the value is edited by runEdit() */
+Workload makeEdit(size_t count)
+{
+    Workload w = makeWorkload("edit", "std::string", runEdit);
+    w.flags = 3;
+    w.specs.push_back("fast");
+    w.specs.push_back("faste");
+    for (size_t i = 2; i < count; ++i)
+        w.storage.push_back("file-" + std::to_string(i));
+    const char* flag[] = { "--mode", "fast" };
+    w.storage.insert(w.storage.begin() + count / 2, flag, flag + 2);
+    finishArgv(w);
+    return w;
+}
+
+/*! \brief The first flag is missing and the second is the last token, so both scan the whole argv */
+Workload makeCheck(size_t count)
+{
+    Workload w = makeWorkload("check", "-", runCheck);
+    for (size_t i = 1; i < count; ++i)
+        w.storage.push_back("arg-" + std::to_string(i));
+    w.storage.push_back("--last");
+    finishArgv(w);
+    return w;
+}
+
+Workload makeHelp(size_t count)
+{
+    Workload w = makeWorkload("help", "int", runHelp);
+    w.flags = count;
+    for (size_t i = 0; i < count; ++i)
+        w.specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i) + " VALUE");
+    w.storage.push_back("--help");
+    finishArgv(w);
+    return w;
+}
+
+/*! \brief Complete '--flag-1', so about a tenth of the aliases are offered at every size */
+Workload makeComplete(size_t count)
+{
+    Workload w = makeWorkload("complete", "int", runComplete);
+    w.flags = count;
+    for (size_t i = 0; i < count; ++i)
+        w.specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i) + " VALUE");
+    const char* query[] = { "--ap-complete", "1", "--", "ap-bench", "--flag-1" };
+    w.storage.insert(w.storage.end(), query, query + 5);
+    finishArgv(w);
+    return w;
+}
+
+/* Measurement ***************************************************************/
+
+double elapsedNs(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/*! \brief Run the warm-up, then repeat until 'repeat' runs or the time budget is spent (at least 5 runs) */
+void measure(const Workload& w, const Options& options)
+{
+    unsigned long sum = 0;
+    double estimate = 0;
+    for (int i = 0; i < std::max(options.warmup, 1); ++i) {
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        sum += w.run(w);
+        estimate = elapsedNs(begin);
+    }
+
+    const double budget = options.budget * 1e9;
+    const size_t repeat = std::max(size_t(5), std::min(size_t(options.repeat), size_t(budget / std::max(estimate, 1.0))));
+    std::vector<double> samples;
+    samples.reserve(repeat);
+    double total = 0;
+    const apbench::AllocCounts allocs = apbench::allocCounts();
+    for (size_t i = 0; i < repeat; ++i) {
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        sum += w.run(w);
+        samples.push_back(elapsedNs(begin));
+        total += samples.back();
+    }
+    const apbench::AllocCounts counts = apbench::allocCountsSince(allocs);
+    std::sort(samples.begin(), samples.end());
+
+    const double mean = total / repeat;
+    const double p50 = samples[repeat / 2];
+    const double p99 = samples[std::min(repeat - 1, repeat * 99 / 100)];
+    std::printf("%s,%s,%zu,%zu,%zu,%.1f,%.3f,%.1f,%.1f,%.1f,%.1f,%lu\n", w.name.c_str(), w.type.c_str(), w.flags, w.tokens(), repeat,
+        mean, w.tokens() ? p50 / w.tokens() : 0.0, p50, p99, double(counts.allocs) / repeat, double(counts.bytes) / repeat, sum);
+    std::fflush(stdout);
+}
+
+bool pinToCpu(int cpu)
+{
+#if defined(__linux__)
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (cpu >= 0 && !sched_setaffinity(0, sizeof(set), &set)) {
+        std::fprintf(stderr, "# pinned to CPU %d\n", cpu);
+        return true;
+    }
+#endif // defined(__linux__)
+    std::fprintf(stderr, "# not pinned to a CPU\n");
+    return false;
+}
+
+} // namespace anonymous
+
+int main(int argc, char* argv[])
+{
+    bool help = PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nRun synthetic parse workloads and print one CSV line per workload.\n\nOptions:", argc, argv);
+    Options options;
+    options.repeat = PARSE_FLAG("-r, --repeat COUNT", 1000, "maximum number of measured runs of a workload. Default is %d.");
+    options.warmup = PARSE_FLAG("-w, --warmup COUNT", 3, "number of not measured runs before the measured ones. Default is %d.");
+    options.budget = PARSE_FLAG("-b, --budget SECONDS", 0.5, "time budget of the measured runs of a workload. Default is %d.");
+    const int cpu = PARSE_FLAG("-c, --cpu CPU", -1, "pin the benchmark to CPU, a negative value means the CPU it starts on.");
+    const bool noPin = PARSE_FLAG("-n, --no-pin", false, "do not pin the benchmark to a CPU.");
+    const size_t maxTokens = PARSE_FLAG("-t, --max-tokens COUNT", size_t(1000000), "largest argv of the PARSE_ARG, CHECK_FLAG and PARSE_EDIT workloads. Default is %d.");
+    const size_t maxFlags = PARSE_FLAG("-f, --max-flags COUNT", size_t(10000), "largest number of defined flags. Default is %d.");
+    const std::string only = PARSE_FLAG("-o, --only NAME", std::string(), "run only the workloads named NAME (flag, arg, check, short, edit, help or complete).");
+    const size_t unparsed = UNPARSED_COUNT();
+    if (help)
+        return 0;
+    if (unparsed) {
+        std::fprintf(stderr, "Unknown arguments, see '%s --help'.\n", argv[0]);
+        return 1;
+    }
+
+    if (!noPin)
+        pinToCpu(cpu);
+
+    // The help workload writes nothing to the terminal.
+    const ap::Writer counter = { countBytes, nullptr };
+    ap::s_stdout = counter;
+
+    std::printf("workload,type,flags,tokens,runs,ns_per_parse,ns_per_token,p50_ns,p99_ns,allocs_per_parse,bytes_per_parse,checksum\n");
+    for (size_t count = 10; count <= maxFlags; count *= 10) {
+        if (!only.empty() && only != "flag")
+            break;
+        measure(makeFlags<int>("int", count), options);
+        measure(makeFlags<float>("float", count), options);
+        measure(makeFlags<std::string>("std::string", count), options);
+        measure(makeFlags<bool>("bool", count), options);
+    }
+    for (size_t count = 10; count <= maxTokens && (only.empty() || only == "arg"); count *= 10)
+        measure(makeArgs(count), options);
+    for (size_t count = 10; count <= maxTokens && (only.empty() || only == "check"); count *= 10)
+        measure(makeCheck(count), options);
+    for (size_t count = 10; count <= maxTokens / 10 && (only.empty() || only == "short"); count *= 10)
+        measure(makeShort(count), options);
+    for (size_t count = 10; count <= maxTokens && (only.empty() || only == "edit"); count *= 10)
+        measure(makeEdit(count), options);
+    for (size_t count = 10; count <= maxFlags && (only.empty() || only == "help"); count *= 10)
+        measure(makeHelp(count), options);
+    for (size_t count = 10; count <= maxFlags && (only.empty() || only == "complete"); count *= 10)
+        measure(makeComplete(count), options);
+
+    return 0;
+}
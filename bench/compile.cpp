@@ -0,0 +1,232 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measure the compile-time cost of the macro API.
+ *
+ * Usage: ap-compile [options], see 'ap-compile --help'.
+ *
+ * Translation units with 0, 10, 100 and 1000 PARSE_FLAG calls are generated with
+ * ap-generate-flags and compiled (only '-c') several times. Every count prints one CSV line
+ * with the median wall and CPU time of the compiler, its peak resident memory and the size
+ * of the object file. The 0 count is the cost of including the header.
+ *
+ * With --baseline FILE the CPU time, the peak memory and the object size are compared with
+ * FILE, and a growth above --tolerance percent fails. The missing values are stored into FILE.
+ */
+
+#include "arg-parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+double now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+double seconds(const timeval& time)
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+struct Sample {
+    double wallSeconds;
+    double cpuSeconds;
+    long peakKiB;
+};
+
+/*! \brief Run 'argv' and wait for it, the usage covers every process it waited for */
+bool run(const std::vector<std::string>& argv, Sample* sample)
+{
+    std::vector<char*> childArgv;
+    for (size_t i = 0; i < argv.size(); ++i)
+        childArgv.push_back(const_cast<char*>(argv[i].c_str()));
+    childArgv.push_back(nullptr);
+
+    const double begin = now();
+    const pid_t pid = fork();
+    if (!pid) {
+        execvp(childArgv[0], childArgv.data());
+        _exit(127);
+    }
+    int status = 0;
+    rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+        return false;
+
+    if (sample) {
+        sample->wallSeconds = now() - begin;
+        sample->cpuSeconds = seconds(usage.ru_utime) + seconds(usage.ru_stime);
+        // The largest of the process and its descendants (cc1plus, as) in KiB on Linux.
+        sample->peakKiB = usage.ru_maxrss;
+    }
+    return true;
+}
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::istringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator))
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+/*! \brief Compare 'value' with the baseline of 'key', or add it to the baseline if it is missing */
+bool checkBaseline(std::map<std::string, double>& baseline, const std::string& key, double value, double tolerance)
+{
+    std::map<std::string, double>::const_iterator it = baseline.find(key);
+    if (it == baseline.end()) {
+        baseline[key] = value;
+        return true;
+    }
+    if (value <= it->second * (1.0 + tolerance / 100.0))
+        return true;
+    std::fprintf(stderr, "%s grew from %g to %g, above the tolerance of %g%%.\n", key.c_str(), it->second, value, tolerance);
+    return false;
+}
+
+} // namespace anonymous
+
+int main(int argc, char* argv[])
+{
+    const std::string self = argv[0];
+    const std::string binDir = self.substr(0, self.find_last_of('/') + 1);
+
+    bool help = PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]\n\nCompile generated translation units with many PARSE_FLAG calls, and print the time, the peak memory and the object size.\n\nOptions:", argc, argv);
+    const std::string counts = PARSE_FLAG("-c, --counts LIST", std::string("0,10,100,1000"), "comma separated PARSE_FLAG counts. Default is '%d'.");
+    const int runs = PARSE_FLAG("-r, --runs COUNT", 3, "number of compiles of every count. Default is %d.");
+    const std::string compiler = PARSE_FLAG("--compiler CXX", std::string("c++"), "the compiler. Default is '%d'.");
+    const std::string flags = PARSE_FLAG("--flags FLAGS", std::string("-std=c++11"), "space separated compiler flags. Default is '%d'.");
+    const std::string include = PARSE_FLAG("-I, --include DIR", std::string("."), "the directory of arg-parser.h. Default is '%d'.");
+    const std::string dir = PARSE_FLAG("-d, --dir DIR", std::string("."), "the directory of the generated files. Default is '%d'.");
+    const std::string baselineFile = PARSE_FLAG("-b, --baseline FILE", std::string(), "compare with the values of FILE, and store the missing ones into it.");
+    const double tolerance = PARSE_FLAG("-t, --tolerance PERCENT", 10.0, "allowed growth above the baseline. Default is %d.");
+    const size_t unparsed = UNPARSED_COUNT();
+    if (help)
+        return 0;
+    if (unparsed || runs < 1) {
+        std::fprintf(stderr, "Wrong arguments, see '%s --help'.\n", argv[0]);
+        return 1;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselineFile.empty()) {
+        std::ifstream file(baselineFile);
+        std::string key;
+        double value;
+        while (file >> key >> value)
+            baseline[key] = value;
+    }
+    const size_t baselineSize = baseline.size();
+
+    std::printf("calls,runs,wall_p50_s,cpu_p50_s,peak_rss_kib,object_bytes,cpu_ms_per_call,object_bytes_per_call\n");
+    bool pass = true;
+    const std::vector<std::string> countList = split(counts, ',');
+    double headerCpu = 0, headerObject = 0;
+    for (size_t c = 0; c < countList.size(); ++c) {
+        const size_t count = std::strtoul(countList[c].c_str(), nullptr, 10);
+        const std::string source = dir + "/compile-" + std::to_string(count) + ".cpp";
+        const std::string object = dir + "/compile-" + std::to_string(count) + ".o";
+
+        std::vector<std::string> generate;
+        generate.push_back(binDir + "ap-generate-flags");
+        generate.push_back(std::to_string(count));
+        generate.push_back(source);
+        std::vector<std::string> compile(1, compiler);
+        const std::vector<std::string> flagList = split(flags, ' ');
+        compile.insert(compile.end(), flagList.begin(), flagList.end());
+        compile.push_back("-I" + include);
+        compile.push_back("-c");
+        compile.push_back(source);
+        compile.push_back("-o");
+        compile.push_back(object);
+
+        std::vector<double> wall, cpu;
+        long peakKiB = 0;
+        Sample sample;
+        bool ok = run(generate, nullptr) && run(compile, nullptr); // Warm up the page cache.
+        for (int r = 0; ok && r < runs; ++r) {
+            ok = run(compile, &sample);
+            wall.push_back(sample.wallSeconds);
+            cpu.push_back(sample.cpuSeconds);
+            peakKiB = std::max(peakKiB, sample.peakKiB);
+        }
+        struct stat objectStat;
+        if (!ok || stat(object.c_str(), &objectStat)) {
+            std::fprintf(stderr, "Cannot compile '%s'.\n", source.c_str());
+            return 1;
+        }
+
+        const double cpuMedian = median(cpu);
+        const double objectBytes = double(objectStat.st_size);
+        if (!count) {
+            headerCpu = cpuMedian;
+            headerObject = objectBytes;
+        }
+        // The per-call costs are above the cost of including the header, if the 0 count ran.
+        const double perCallCpu = count ? (cpuMedian - headerCpu) * 1e3 / count : 0;
+        const double perCallObject = count ? (objectBytes - headerObject) / count : 0;
+        std::printf("%zu,%d,%.3f,%.3f,%ld,%.0f,%.3f,%.0f\n", count, runs, median(wall), cpuMedian, peakKiB, objectBytes, perCallCpu, perCallObject);
+        std::fflush(stdout);
+
+        if (!baselineFile.empty()) {
+            const std::string key = "compile-" + std::to_string(count) + "-";
+            pass = checkBaseline(baseline, key + "cpu_s", cpuMedian, tolerance) && pass;
+            pass = checkBaseline(baseline, key + "peak_rss_kib", double(peakKiB), tolerance) && pass;
+            pass = checkBaseline(baseline, key + "object_bytes", objectBytes, tolerance) && pass;
+        }
+    }
+
+    if (baseline.size() != baselineSize) {
+        std::ofstream file(baselineFile);
+        for (std::map<std::string, double>::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+            file << it->first << " " << it->second << "\n";
+    }
+    return pass ? 0 : 1;
+}
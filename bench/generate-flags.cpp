@@ -0,0 +1,107 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Generate a program which defines many flags with PARSE_FLAG, for measuring the cost of
+ * the macro API in compile time, binary size and startup time.
+ *
+ * Usage: ap-generate-flags [--timestamps] COUNT [OUTPUT]
+ *
+ * With --timestamps the program also takes every argument with PARSE_ARG, and writes the
+ * CLOCK_MONOTONIC times of entering main, finishing PARSE_HELP and finishing the parse to
+ * the file descriptor 3 (see ap-startup).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+struct FlagType {
+    const char* type;
+    const char* defaultValue;
+    const char* valueName;
+    const char* use;
+};
+
+const FlagType s_types[] = {
+    { "int", "%zu", " VALUE", "flag%zu" },
+    { "float", "%zu.5f", " VALUE", "flag%zu" },
+    { "std::string", "std::string(\"value-%zu\")", " VALUE", "flag%zu.size()" },
+    { "bool", "false", "", "flag%zu" },
+    { "char", "'c'", " CHAR", "flag%zu" },
+};
+
+} // namespace anonymous
+
+int main(int argc, char* argv[])
+{
+    const bool timestamps = argc > 1 && !std::strcmp(argv[1], "--timestamps");
+    const int first = timestamps ? 2 : 1;
+    const long count = argc > first ? std::strtol(argv[first], nullptr, 10) : -1;
+    if (count < 0) {
+        std::fprintf(stderr, "Usage: %s [--timestamps] COUNT [OUTPUT]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* out = argc > first + 1 ? std::fopen(argv[first + 1], "w") : stdout;
+    if (!out) {
+        std::perror(argv[first + 1]);
+        return 1;
+    }
+
+    std::fprintf(out, "/* Generated by ap-generate-flags%s %ld. */\n\n", timestamps ? " --timestamps" : "", count);
+    std::fprintf(out, "#include \"arg-parser.h\"\n\n#include <string>\n\n");
+    if (timestamps)
+        std::fprintf(out, "#include <time.h>\n#include <unistd.h>\n\n");
+    std::fprintf(out, "int main(int argc, char* argv[])\n{\n");
+    if (timestamps)
+        std::fprintf(out, "    timespec times[3];\n    clock_gettime(CLOCK_MONOTONIC, &times[0]);\n");
+    std::fprintf(out, "    bool help = PARSE_HELP(\"-h, --help\", \"show this help.\", \"Usage: %%p [options]\\n\\nOptions:\", argc, argv);\n");
+    if (timestamps)
+        std::fprintf(out, "    clock_gettime(CLOCK_MONOTONIC, &times[1]);\n");
+    for (size_t i = 0; i < size_t(count); ++i) {
+        const FlagType& type = s_types[i % (sizeof(s_types) / sizeof(s_types[0]))];
+        std::fprintf(out, "    %s flag%zu = PARSE_FLAG(\"-f%zu, --flag-%zu%s\", ", type.type, i, i, i, type.valueName);
+        std::fprintf(out, type.defaultValue, i);
+        std::fprintf(out, ", \"set flag %zu. Default is '%%d'.\");\n", i);
+    }
+    std::fprintf(out, "    FLUSH_HELP();\n\n    unsigned long checksum = help;\n");
+    if (timestamps) {
+        std::fprintf(out, "    for (size_t i = UNPARSED_COUNT(); i; --i)\n        checksum += PARSE_ARG(std::string()).size();\n");
+        std::fprintf(out, "    clock_gettime(CLOCK_MONOTONIC, &times[2]);\n");
+        std::fprintf(out, "    checksum += write(3, times, sizeof(times)) != sizeof(times);\n");
+    }
+    for (size_t i = 0; i < size_t(count); ++i) {
+        const FlagType& type = s_types[i % (sizeof(s_types) / sizeof(s_types[0]))];
+        std::fprintf(out, "    checksum += ");
+        std::fprintf(out, type.use, i);
+        std::fprintf(out, ";\n");
+    }
+    std::fprintf(out, "\n    return checksum == 1 ? 1 : 0;\n}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+    return 0;
+}
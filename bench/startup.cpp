@@ -0,0 +1,213 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Measure the startup latency of a program generated by 'ap-generate-flags --timestamps'.
+ *
+ * Usage: ap-startup [options] [CLI], see 'ap-startup --help'.
+ *
+ * The CLI is forked and executed many times with argv from empty to nearly ARG_MAX bytes.
+ * The child writes the time before execv, and the CLI writes the times of entering main,
+ * finishing PARSE_HELP and finishing the parse into a pipe on the file descriptor 3, so
+ * the startup is split into:
+ *   exec        execv, the dynamic loader and the static initialization, until main
+ *   tokenize    PARSE_HELP, which splits argv into tokens
+ *   parse       the PARSE_FLAG and PARSE_ARG calls, with the lookups and conversions
+ *   exit        from the end of the parse until waitpid returns
+ * Every argv size prints one CSV line to stdout with the p50 and p99 in microseconds.
+ */
+
+#include "arg-parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+double now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e6 + time.tv_nsec / 1e3;
+}
+
+double micros(const timespec& time)
+{
+    return time.tv_sec * 1e6 + time.tv_nsec / 1e3;
+}
+
+enum Phase { Exec, Tokenize, Parse, Exit, Total, PhaseCount };
+const char* const s_phaseNames[PhaseCount] = { "exec", "tokenize", "parse", "exit", "total" };
+
+/*! \brief Read exactly 'size' bytes, or return false */
+bool readAll(int fd, void* data, size_t size)
+{
+    char* pos = static_cast<char*>(data);
+    while (size) {
+        const ssize_t result = read(fd, pos, size);
+        if (result <= 0)
+            return false;
+        pos += result;
+        size -= result;
+    }
+    return true;
+}
+
+/*! \brief Run the CLI once and add the microseconds of its phases to 'samples' */
+bool runOnce(const std::string& cli, const std::vector<char*>& argv, std::vector<double> (&samples)[PhaseCount])
+{
+    int fds[2];
+    if (pipe(fds))
+        return false;
+
+    const double begin = now();
+    const pid_t pid = fork();
+    if (!pid) {
+        // Only async-signal-safe calls until execv.
+        timespec beforeExec;
+        clock_gettime(CLOCK_MONOTONIC, &beforeExec);
+        const int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(fds[1], 3);
+        if (write(3, &beforeExec, sizeof(beforeExec)) == sizeof(beforeExec))
+            execv(cli.c_str(), argv.data());
+        _exit(127);
+    }
+    close(fds[1]);
+
+    timespec times[4];
+    const bool ok = pid > 0 && readAll(fds[0], times, sizeof(times));
+    close(fds[0]);
+    int status = 0;
+    if (pid > 0)
+        waitpid(pid, &status, 0);
+    const double end = now();
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) == 127)
+        return false;
+
+    samples[Exec].push_back(micros(times[1]) - micros(times[0]));
+    samples[Tokenize].push_back(micros(times[2]) - micros(times[1]));
+    samples[Parse].push_back(micros(times[3]) - micros(times[2]));
+    samples[Exit].push_back(end - micros(times[3]));
+    samples[Total].push_back(end - begin);
+    return true;
+}
+
+/*! \brief Arguments of about 'bytes' bytes: every flag of the CLI once with a value, then positional arguments */
+std::vector<std::string> makeArguments(size_t bytes, size_t flagCount)
+{
+    std::vector<std::string> arguments;
+    size_t size = 0;
+    for (size_t i = 0; size < bytes; ++i) {
+        std::string argument = i < 2 * flagCount
+            ? (i % 2 ? std::to_string(i / 2) : "--flag-" + std::to_string(i / 2))
+            : "arg-" + std::to_string(i);
+        // bool flags have no value, see the flag types of ap-generate-flags.
+        if (i < 2 * flagCount && i % 2 && (i / 2) % 5 == 3)
+            continue;
+        size += argument.size() + 1 + sizeof(char*);
+        arguments.push_back(argument);
+    }
+    return arguments;
+}
+
+size_t environmentSize()
+{
+    size_t size = 0;
+    for (char** env = environ; *env; ++env)
+        size += std::string(*env).size() + 1 + sizeof(char*);
+    return size;
+}
+
+} // namespace anonymous
+
+int main(int argc, char* argv[])
+{
+    const std::string self = argv[0];
+    const std::string defaultCli = self.substr(0, self.find_last_of('/') + 1) + "ap-startup-cli";
+
+    bool help = PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options] [CLI]\n\nRun a CLI generated by 'ap-generate-flags --timestamps' with growing argv, and print the phases of its startup.\n\nOptions:", argc, argv);
+    const int runs = PARSE_FLAG("-r, --runs COUNT", 50, "number of runs of every argv size. Default is %d.");
+    const size_t flagCount = PARSE_FLAG("-f, --flags COUNT", size_t(300), "number of flags of the CLI, every one is given once. Default is %d.");
+    const std::string cli = PARSE_ARG(defaultCli);
+    const size_t unparsed = UNPARSED_COUNT();
+    if (help)
+        return 0;
+    if (unparsed) {
+        std::fprintf(stderr, "Unknown arguments, see '%s --help'.\n", argv[0]);
+        return 1;
+    }
+
+    // Linux also limits a single argument to 32 pages, the arguments here are short.
+    const long argMax = sysconf(_SC_ARG_MAX);
+    const size_t limit = size_t(argMax) - environmentSize() - cli.size() - 4096;
+    std::fprintf(stderr, "# ARG_MAX is %ld, argv is at most %zu bytes\n", argMax, limit);
+
+    std::vector<size_t> sizes(1, 0);
+    for (size_t bytes = 1024; bytes < limit; bytes *= 4)
+        sizes.push_back(bytes);
+    sizes.push_back(limit);
+
+    std::printf("argv_bytes,args,runs");
+    for (size_t phase = 0; phase < PhaseCount; ++phase)
+        std::printf(",%s_p50_us,%s_p99_us", s_phaseNames[phase], s_phaseNames[phase]);
+    std::printf("\n");
+
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        const std::vector<std::string> arguments = makeArguments(sizes[s], flagCount);
+        std::vector<char*> childArgv(1, const_cast<char*>(cli.c_str()));
+        for (size_t i = 0; i < arguments.size(); ++i)
+            childArgv.push_back(const_cast<char*>(arguments[i].c_str()));
+        childArgv.push_back(nullptr);
+
+        std::vector<double> samples[PhaseCount];
+        runOnce(cli, childArgv, samples); // Warm up the page cache.
+        for (size_t phase = 0; phase < PhaseCount; ++phase)
+            samples[phase].clear();
+        for (int run = 0; run < runs; ++run)
+            if (!runOnce(cli, childArgv, samples)) {
+                std::fprintf(stderr, "Cannot run '%s' with %zu arguments.\n", cli.c_str(), arguments.size());
+                return 1;
+            }
+
+        std::printf("%zu,%zu,%d", sizes[s], arguments.size(), runs);
+        for (size_t phase = 0; phase < PhaseCount; ++phase) {
+            std::vector<double>& values = samples[phase];
+            std::sort(values.begin(), values.end());
+            std::printf(",%.1f,%.1f", values[values.size() / 2], values[std::min(values.size() - 1, values.size() * 99 / 100)]);
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+    return 0;
+}
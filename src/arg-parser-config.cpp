@@ -0,0 +1,303 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "arg-parser-config.h"
+
+#include <cstdio>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif // defined(__linux__)
+
+namespace ap {
+
+namespace {
+
+const int s_reclaim_ms = 100; /*< The watcher retries freeing the replaced snapshots this often. */
+
+/*! \brief Read the file of 'path' into 'text', return false if it cannot be read */
+bool read_file(const std::string& path, std::vector<char>& text)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    char buffer[4096];
+    text.clear();
+    while (const size_t size = std::fread(buffer, 1, sizeof(buffer), file))
+        text.insert(text.end(), buffer, buffer + size);
+    const bool failed = std::ferror(file);
+    std::fclose(file);
+    return !failed;
+}
+
+/*! \brief Split 'text' into NUL terminated words in place, and point 'argv' to them after 'program'
+ *
+ *  The words are separated by white space, a quoted part keeps it (without escapes), and '#'
+ *  at the start of a word comments out the rest of the line.
+ */
+void split_words(std::vector<char>& text, const char* program, std::vector<const char*>& argv)
+{
+    argv.assign(1, program);
+    text.push_back('\0');
+    const size_t size = text.size() - 1;
+    size_t out = 0;
+    size_t i = 0;
+    while (i < size) {
+        const char c = text[i];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            ++i;
+        } else if (c == '#') {
+            while (i < size && text[i] != '\n')
+                ++i;
+        } else {
+            const size_t word = out;
+            while (i < size && text[i] != ' ' && text[i] != '\t' && text[i] != '\n' && text[i] != '\r') {
+                if (text[i] == '"' || text[i] == '\'') {
+                    const char quote = text[i++];
+                    while (i < size && text[i] != quote)
+                        text[out++] = text[i++];
+                    i += i < size;
+                } else {
+                    text[out++] = text[i++];
+                }
+            }
+            // The end of the word may overwrite the separator, so that is skipped first.
+            i += i < size;
+            text[out++] = '\0';
+            argv.push_back(&text[word]);
+        }
+    }
+    // The words only shrink, they are written behind the reading position.
+    text.resize(out);
+}
+
+} // namespace anonymous
+
+ConfigWatcher::ConfigWatcher(const StringRef& path, Load load, Release release, bool watchFile)
+    : m_path(path.str())
+    , m_load(load)
+    , m_release(release)
+    , m_current(nullptr)
+    , m_version(0)
+    , m_epoch(0)
+    , m_notify(-1)
+    , m_work(nullptr)
+    , m_work_stop(false)
+{
+    m_readers[0] = 0;
+    m_readers[1] = 0;
+    m_stop[0] = m_stop[1] = -1;
+    m_worker = std::thread(&ConfigWatcher::work, this);
+    if (!reload_file(false)) {
+        std::vector<char> text;
+        const std::vector<const char*> argv(1, m_path.c_str());
+        publish(parse_words(text, argv, false), 1);
+    }
+
+#if defined(__linux__)
+    if (!watchFile)
+        return;
+    // The directory is watched, editors replace the file by renaming a new one over it. A file
+    // is reloaded when it is closed after writing, not while it is written.
+    const size_t slash = m_path.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash ? m_path.substr(0, slash) : "/";
+    m_notify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (m_notify >= 0 && inotify_add_watch(m_notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0 && !pipe(m_stop)) {
+        m_thread = std::thread(&ConfigWatcher::watch, this);
+    } else if (m_notify >= 0) {
+        close(m_notify);
+        m_notify = -1;
+    }
+#endif // defined(__linux__)
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+#if defined(__linux__)
+    if (m_thread.joinable()) {
+        const char stop = 0;
+        const ssize_t written = write(m_stop[1], &stop, 1);
+        (void)written;
+        m_thread.join();
+        close(m_stop[0]);
+        close(m_stop[1]);
+        close(m_notify);
+    }
+#endif // defined(__linux__)
+    {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        m_work_stop = true;
+    }
+    m_work_changed.notify_all();
+    m_worker.join();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_retired.size(); ++i)
+        m_release(m_retired[i].snapshot);
+    m_release(m_current.load());
+}
+
+bool ConfigWatcher::reload()
+{
+    return reload_file(false);
+}
+
+size_t ConfigWatcher::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_retired.size();
+}
+
+const void* ConfigWatcher::pin(unsigned& epoch) const
+{
+    epoch = unsigned(m_epoch.load() & 1);
+    m_readers[epoch].fetch_add(1);
+    return m_current.load();
+}
+
+void ConfigWatcher::unpin(unsigned epoch) const
+{
+    m_readers[epoch].fetch_sub(1);
+}
+
+bool ConfigWatcher::reload_file(bool watcher)
+{
+    std::vector<char> text;
+    std::vector<const char*> argv;
+    if (!read_file(m_path, text))
+        return false;
+    split_words(text, m_path.c_str(), argv);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const void* snapshot = parse_words(text, argv, watcher);
+    if (!snapshot)
+        return false;
+    publish(snapshot, m_version.load() + 1);
+    return true;
+}
+
+/*! \brief Parse the words with m_load in a thread which parses nothing else, the parse state of other threads is kept
+ *
+ *  The parse state is thread local, so the watcher thread parses in place, but the parse of
+ *  argv in the thread calling reload() must not be replaced, that one is parsed by the worker.
+ */
+const void* ConfigWatcher::parse_words(std::vector<char>& text, const std::vector<const char*>& argv, bool watcher)
+{
+    const void* snapshot = nullptr;
+    const void* current = m_current.load();
+    const std::function<void()> parse = [&]() { snapshot = m_load(text, int(argv.size()), argv.data(), current); };
+    if (watcher) {
+        parse();
+    } else {
+        std::unique_lock<std::mutex> lock(m_work_mutex);
+        m_work = &parse;
+        m_work_changed.notify_all();
+        m_work_changed.wait(lock, [this]() { return !m_work; });
+    }
+    return snapshot;
+}
+
+/*! \brief Run the requested parses until the destructor stops the worker */
+void ConfigWatcher::work()
+{
+    std::unique_lock<std::mutex> lock(m_work_mutex);
+    for (;;) {
+        m_work_changed.wait(lock, [this]() { return m_work || m_work_stop; });
+        if (!m_work)
+            return;
+        (*m_work)();
+        m_work = nullptr;
+        m_work_changed.notify_all();
+    }
+}
+
+/*! \brief Swap in 'snapshot', the replaced one is freed by reclaim() once no reader can see it */
+void ConfigWatcher::publish(const void* snapshot, unsigned long version)
+{
+    if (const void* previous = m_current.exchange(snapshot)) {
+        const Retired retired = { previous, m_epoch.load() };
+        m_retired.push_back(retired);
+    }
+    m_version.store(version, std::memory_order_release);
+    reclaim();
+}
+
+/*! \brief Flip the epoch while the readers of the other parity are gone, and free the snapshots replaced two flips ago
+ *
+ *  A reader counts itself before it loads the snapshot pointer. So a reader of a replaced
+ *  snapshot is counted in one of the parities when they are checked after the swap, and
+ *  both of them are checked by two flips. The writer never waits for the readers, it tries
+ *  again later.
+ */
+void ConfigWatcher::reclaim()
+{
+    for (int flip = 0; flip < 2 && !m_retired.empty(); ++flip) {
+        const unsigned long epoch = m_epoch.load();
+        if (m_readers[(epoch + 1) & 1].load())
+            break;
+        m_epoch.store(epoch + 1);
+    }
+    const unsigned long epoch = m_epoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < m_retired.size(); ++i) {
+        if (epoch >= m_retired[i].epoch + 2)
+            m_release(m_retired[i].snapshot);
+        else
+            m_retired[kept++] = m_retired[i];
+    }
+    m_retired.resize(kept);
+}
+
+/*! \brief Reload on the changes of the file until the destructor writes to the stop pipe */
+void ConfigWatcher::watch()
+{
+#if defined(__linux__)
+    const std::string name = m_path.substr(m_path.rfind('/') + 1);
+    pollfd fds[2] = { { m_notify, POLLIN, 0 }, { m_stop[0], POLLIN, 0 } };
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        const int timeout = pending() ? s_reclaim_ms : -1;
+        if (poll(fds, 2, timeout) < 0)
+            continue;
+        if (fds[1].revents)
+            return;
+        bool changed = false;
+        ssize_t size;
+        while ((size = read(m_notify, buffer, sizeof(buffer))) > 0)
+            for (char* event = buffer; event < buffer + size;) {
+                const inotify_event* header = reinterpret_cast<const inotify_event*>(event);
+                changed = changed || (header->len && name == header->name);
+                event += sizeof(inotify_event) + header->len;
+            }
+        if (!changed || !reload_file(true)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            reclaim();
+        }
+    }
+#endif // defined(__linux__)
+}
+
+} // namespace ap
@@ -0,0 +1,207 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARG_PARSER_CONFIG_H
+#define ARG_PARSER_CONFIG_H
+
+/* Hot-reloaded config files of the options declared with AP_OPTIONS, in the arg-parser-config
+ * library. The watcher thread parses the file again when it changes, and publishes the result
+ * as a new immutable snapshot. The readers pin the current snapshot with two atomic counters
+ * and never wait, the replaced snapshots are freed when no reader can see them anymore.
+ */
+
+#include "arg-parser.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ap {
+
+/*! \brief A parse of a config file, immutable once published, see ap::Config */
+template <typename Options>
+struct ConfigSnapshot {
+    unsigned long version; /*< 1 for the first parse, increased by every reload which changes anything. */
+    Options options;
+    unsigned long versions[Options::OptionCount]; /*< The version where each option got its value. */
+    size_t unparsed; /*< Words of the file which are not options. */
+    std::vector<char> text; /*< The words of the file, StringRef options point into it. */
+
+    /*! \brief Return true if the option of 'index' (like MyOptions::size_index) changed after 'version' */
+    bool changed_since(size_t index, unsigned long since) const { return versions[index] > since; }
+};
+
+/*! \brief The type independent part of ap::Config: the file, the watcher thread and the snapshot pointer */
+class ConfigWatcher {
+public:
+    /*! \brief Parse the words of the file (argv[0] is its path) into a new snapshot after 'current', or return nullptr if nothing changed */
+    typedef const void* (*Load)(std::vector<char>& text, int argc, const char* const* argv, const void* current);
+    typedef void (*Release)(const void* snapshot);
+
+    ConfigWatcher(const StringRef& path, Load load, Release release, bool watchFile);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    void operator=(const ConfigWatcher&) = delete;
+
+    /*! \brief Read and parse the file now, return true if a new snapshot is published
+     *
+     *  A missing or unreadable file publishes nothing, neither does a file which changes no
+     *  option. The watcher thread reloads on every change, so it is needed only where inotify
+     *  is not available. The file is parsed by a worker thread of the object, the parse of
+     *  the calling thread is kept.
+     */
+    bool reload();
+
+    /*! \brief Return the version of the current snapshot, without pinning it */
+    unsigned long version() const { return m_version.load(std::memory_order_acquire); }
+
+    /*! \brief Return the number of replaced snapshots which are not freed yet, because a reader may see them */
+    size_t pending() const;
+
+    /*! \brief Return true if a thread watches the file */
+    bool watching() const { return m_thread.joinable(); }
+
+protected:
+    const void* pin(unsigned& epoch) const;
+    void unpin(unsigned epoch) const;
+
+private:
+    bool reload_file(bool watcher);
+    const void* parse_words(std::vector<char>& text, const std::vector<const char*>& argv, bool watcher);
+    void publish(const void* snapshot, unsigned long version);
+    void reclaim();
+    void watch();
+    void work();
+
+    struct Retired {
+        const void* snapshot;
+        unsigned long epoch; /*< m_epoch when it was replaced. */
+    };
+
+    std::string m_path;
+    Load m_load;
+    Release m_release;
+    std::atomic<const void*> m_current;
+    std::atomic<unsigned long> m_version;
+    /* A reader counts itself in the counter of the epoch's parity. Each flip waits until the
+     * other counter drops to zero, so a snapshot replaced before two flips has no reader.
+     */
+    std::atomic<unsigned long> m_epoch;
+    alignas(64) mutable std::atomic<unsigned long> m_readers[2];
+    mutable std::mutex m_mutex; /*< Serializes the reloads and the reclamation. */
+    std::vector<Retired> m_retired;
+    int m_notify; /*< inotify descriptor of the directory of the file, or -1. */
+    int m_stop[2]; /*< Pipe waking the watcher thread up for exiting. */
+    std::thread m_thread;
+    /* The parses requested by other threads run in the worker, on a parser state of its own. */
+    std::mutex m_work_mutex;
+    std::condition_variable m_work_changed;
+    const std::function<void()>* m_work; /*< The requested parse, null when it is done. */
+    bool m_work_stop;
+    std::thread m_worker;
+};
+
+/*! \brief The options of AP_OPTIONS read from a config file, parsed again whenever it changes
+ *
+ *  The file has the flags of argv as words, separated by white space or in quotes, and '#'
+ *  starts a comment until the end of the line. It is parsed like argv, without help.
+ *
+ *      ap::Config<MyOptions> config("/etc/my-daemon.conf");
+ *      ap::Config<MyOptions>::Reader options = config.read();
+ *      resize(options->options.size);
+ */
+template <typename Options>
+class Config : public ConfigWatcher {
+public:
+    typedef ConfigSnapshot<Options> Snapshot;
+
+    /*! \brief Pins the snapshot which was current when it was made, until it is destroyed */
+    class Reader {
+    public:
+        explicit Reader(const Config& config) : m_config(&config), m_snapshot(static_cast<const Snapshot*>(config.pin(m_epoch))) {}
+        Reader(Reader&& other) : m_config(other.m_config), m_snapshot(other.m_snapshot), m_epoch(other.m_epoch) { other.m_config = nullptr; }
+        ~Reader()
+        {
+            if (m_config)
+                m_config->unpin(m_epoch);
+        }
+
+        Reader(const Reader&) = delete;
+        void operator=(const Reader&) = delete;
+
+        const Snapshot& operator*() const { return *m_snapshot; }
+        const Snapshot* operator->() const { return m_snapshot; }
+
+    private:
+        const Config* m_config;
+        const Snapshot* m_snapshot;
+        unsigned m_epoch;
+    };
+
+    /*! \brief Parse 'path' and start watching it if 'watchFile', the options are the defaults if it cannot be read */
+    explicit Config(const StringRef& path, bool watchFile = true) : ConfigWatcher(path, load, release, watchFile) {}
+
+    Reader read() const { return Reader(*this); }
+
+    /*! \brief Return true if the option of 'index' changed after 'version', in the current snapshot */
+    bool changed_since(size_t index, unsigned long since) const { return read()->changed_since(index, since); }
+
+private:
+    static const void* load(std::vector<char>& text, int argc, const char* const* argv, const void* current)
+    {
+        const Snapshot* previous = static_cast<const Snapshot*>(current);
+        Snapshot* snapshot = new Snapshot();
+        snapshot->version = previous ? previous->version + 1 : 1;
+        PARSE_HELP("", "", "", argc, argv);
+        PARSE_OPTIONS(snapshot->options);
+        snapshot->unparsed = ap::unparsed_count();
+        for (size_t i = 0; i < size_t(Options::OptionCount); ++i)
+            snapshot->versions[i] = previous ? previous->versions[i] : snapshot->version;
+        if (previous) {
+            snapshot->options.stamp_changes(previous->options, snapshot->versions, snapshot->version);
+            bool changed = snapshot->unparsed != previous->unparsed;
+            for (size_t i = 0; i < size_t(Options::OptionCount) && !changed; ++i)
+                changed = snapshot->versions[i] == snapshot->version;
+            if (!changed) {
+                delete snapshot;
+                return nullptr;
+            }
+        }
+        snapshot->text.swap(text);
+        return snapshot;
+    }
+
+    static void release(const void* snapshot)
+    {
+        delete static_cast<const Snapshot*>(snapshot);
+    }
+};
+
+} // namespace ap
+
+#endif // ARG_PARSER_CONFIG_H
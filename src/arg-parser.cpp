@@ -0,0 +1,2051 @@
+/* Copyright (C) 2018, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "arg-parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#if defined(AP_STATS)
+#include <chrono>
+#endif // defined(AP_STATS)
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif // defined(__unix__) || defined(__APPLE__)
+
+namespace ap {
+
+namespace {
+
+#if defined(AP_STATS)
+
+thread_local Stats s_stats; /*< Zero initialized, reset by parse_help(). */
+
+/*! \brief Add the lifetime of the timer to the seconds of a phase in 's_stats' */
+struct PhaseTimer {
+    explicit PhaseTimer(double& seconds) : seconds(seconds), begin(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() { seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(); }
+
+    double& seconds;
+    const std::chrono::steady_clock::time_point begin;
+};
+
+#define AP_COUNT(COUNTER, N) (s_stats.COUNTER += (N))
+#define AP_PHASE(PHASE) const PhaseTimer phaseTimer(s_stats.PHASE##Seconds)
+#define AP_RESET_STATS() (s_stats = Stats())
+
+#else // !defined(AP_STATS)
+
+#define AP_COUNT(COUNTER, N) ((void)0)
+#define AP_PHASE(PHASE) ((void)0)
+#define AP_RESET_STATS() ((void)0)
+
+#endif // defined(AP_STATS)
+
+/*! \brief Growable array of trivial items
+ *
+ *  It has no constructor and destructor, so the arrays of the parser state are constant
+ *  initialized. The memory is kept until the end of the process and reused by the next parse.
+ */
+template <typename T>
+struct Array {
+    T* data;
+    size_t size;
+    size_t capacity;
+
+    void reserve(size_t count)
+    {
+        if (count <= capacity)
+            return;
+        const size_t newCapacity = std::max(count, 2 * capacity);
+        T* newData = static_cast<T*>(std::realloc(data, newCapacity * sizeof(T)));
+        if (!newData)
+            throw std::bad_alloc();
+        data = newData;
+        capacity = newCapacity;
+    }
+
+    void push_back(const T& item)
+    {
+        reserve(size + 1);
+        data[size++] = item;
+    }
+
+    void append(const T* items, size_t count)
+    {
+        // An empty array has no data, and memcpy() takes no null pointer even for zero bytes.
+        if (!count)
+            return;
+        reserve(size + count);
+        std::memcpy(data + size, items, count * sizeof(T));
+        size += count;
+    }
+};
+
+/*! \brief An argument, or a part of it if it was split at 's_long_flag_delimiter'
+ *
+ *  A bundled short option (the 'v' of '-xvf') has its prefix in 'prefix' and only its
+ *  character at 'data', it points into argv like the other tokens.
+ */
+struct Token {
+    const char* data;
+    size_t size;
+    unsigned used; /*< The parse which used the token, see s_parse. */
+    char prefix;
+};
+
+/* Every thread parses on its own state. The arrays of a thread are not freed when it exits. */
+
+thread_local Array<Token> s_tokens = { nullptr, 0, 0 };
+thread_local size_t s_unused = 0; /*< Number of not used tokens after the program name. */
+thread_local size_t s_next_arg = 1; /*< No token is unused before this one. */
+thread_local unsigned s_parse = 1; /*< The tokens used by the current parse have this in 'used'. */
+/* One allocation: a hash table of the token texts with the first token of a text (or 0) in
+ * its 's_token_slots' slots, then for every token the next token of the same text (or 0) and
+ * its home, see alias_home(). A slot whose tokens are all removed by an edit is a Tombstone.
+ */
+thread_local Array<size_t> s_token_index = { nullptr, 0, 0 };
+thread_local size_t s_token_slots = 0;
+thread_local size_t s_token_tombstones = 0;
+const size_t Tombstone = ~size_t(0);
+thread_local bool s_tokens_indexed = false;
+const size_t s_index_min_tokens = 32; /*< Shorter argv is scanned, that is faster than hashing it. */
+thread_local Array<Token> s_taken = { nullptr, 0, 0 }; /*< Arguments of the last take_flags(). */
+thread_local Array<size_t> s_taken_tokens = { nullptr, 0, 0 }; /*< The first token of each of 's_taken'. */
+
+/* The short flags of the prefixes in 's_short_flag_prefixes' are indexed in a 256-entry row
+ * per prefix instead of the hash table, so they are found with one load.
+ */
+enum { ShortPrefixCapacity = 4 };
+thread_local const char* s_short_prefixes_of_rows = nullptr; /*< The prefixes 's_short_row' is made of. */
+thread_local unsigned char s_short_row[256] = {}; /*< 1 + the row of a prefix character, or 0. */
+thread_local size_t s_short_rows = 0;
+thread_local size_t s_short_first[ShortPrefixCapacity][256] = {}; /*< The first token of a short flag, or 0. */
+thread_local int s_argc = 0;
+thread_local const char* const* s_argv = nullptr;
+thread_local size_t s_help_token = 0; /*< The first help flag, if the help is requested. */
+
+/*! \brief A head of a chain before its used tokens were skipped, see skip_used() */
+struct Compression {
+    size_t* head;
+    size_t first;
+};
+
+/* The state kept for the next edit, see parse_edit(). */
+
+thread_local bool s_incremental = false; /*< The parse is started by parse_edit(). */
+thread_local Array<Compression> s_compressions = { nullptr, 0, 0 }; /*< The skips of the chains in this parse. */
+thread_local Array<size_t> s_arg_tokens = { nullptr, 0, 0 }; /*< The first token of every argument, then the token count. */
+thread_local Array<Token> s_edit_tokens = { nullptr, 0, 0 }; /*< The tokens of the new arguments of an edit. */
+
+/*! \brief A subcommand, with its name in 's_command_names' */
+struct Command {
+    size_t name, nameSize;
+    CommandHandler handler;
+};
+
+thread_local Array<Command> s_commands = { nullptr, 0, 0 };
+thread_local Array<char> s_command_names = { nullptr, 0, 0 };
+thread_local Array<size_t> s_command_slots = { nullptr, 0, 0 }; /*< Open addressing hash table of 1 + the command indices. */
+thread_local bool s_commands_changed = false;
+thread_local size_t s_end = 0; /*< The subcommand token, or the token count. Later tokens are not parsed. */
+thread_local size_t s_end_unused = 0; /*< Not used tokens from 's_end'. */
+thread_local size_t s_command = 0; /*< Index of the subcommand at 's_end'. */
+thread_local int s_command_arg = 0; /*< Index of the subcommand in argv. */
+
+/*! \brief One line of the help page: a flag spec with its description, or a free text if spec is empty */
+struct HelpEntry {
+    size_t spec, specSize;
+    size_t text, textSize;
+};
+
+thread_local Array<HelpEntry> s_help_entries = { nullptr, 0, 0 };
+thread_local Array<char> s_help_buffer = { nullptr, 0, 0 }; /*< Bytes of all specs and texts, entries point into it. */
+thread_local size_t s_help_longest_spec = 0;
+thread_local bool s_help_pending = false; /*< The page of this parse is not taken yet, see flush_pending_help(). */
+thread_local Writer s_help_out = { nullptr, nullptr }; /*< AP_STDOUT of the PARSE_HELP of the pending page. */
+
+/* The query of a completion, see parse_help(). The candidates are collected as help entries
+ * without text, only the ones starting with the completed word.
+ */
+thread_local const char* s_complete_word = ""; /*< The completed word, or its part after the delimiter. */
+thread_local size_t s_complete_word_size = 0;
+thread_local size_t s_complete_lead = 0; /*< Size of the '--flag=' before the completed part. */
+thread_local const char* s_complete_flag = nullptr; /*< The flag of the completed value, or null. */
+thread_local size_t s_complete_flag_size = 0;
+thread_local bool s_complete_delimited = false; /*< The flag is given with a delimiter, it takes a value for sure. */
+thread_local bool s_complete_values = false; /*< Only values are completed, the flag is found or delimited. */
+thread_local bool s_complete_nested = false; /*< The query goes on in the handler of a subcommand. */
+thread_local const char* s_complete_shell = nullptr; /*< The shell of a requested script, or null. */
+
+/* The errors are recorded into a fixed buffer, with the definition and the value being
+ * parsed, and they are formatted only on request. A parse without errors only notes its
+ * definitions, the suggestions are looked up among them when an error is formatted.
+ */
+struct Definition {
+    size_t flags; /*< The spec given to PARSE_FLAG in the spec bytes, empty for an argument. */
+    size_t size;
+};
+
+struct Choices {
+    size_t spec; /*< The definition of the flag, from 1. */
+    size_t data; /*< The ADD_CHOICES of the flag in the spec bytes. */
+    size_t size;
+};
+
+/* The specs may be temporary strings, and the suggestions need all of them after the parse,
+ * so the spec of every definition is copied, see copy_spec(). The definitions of a usual
+ * program fit the inline buffers. A longer list allocates while the buffers grow on its first
+ * parse, the later parses reuse them. An error refers to the definition being parsed by its
+ * index from 1.
+ */
+const size_t InlineDefinitions = 256;
+thread_local Definition s_inline_definitions[InlineDefinitions];
+thread_local Array<Definition> s_more_definitions = { nullptr, 0, 0 };
+thread_local size_t s_definition_count = 0;
+thread_local Array<Choices> s_choices = { nullptr, 0, 0 };
+const size_t InlineSpecBytes = 4096;
+thread_local char s_inline_spec_bytes[InlineSpecBytes];
+thread_local Array<char> s_more_spec_bytes = { nullptr, 0, 0 }; /*< The bytes from InlineSpecBytes. */
+thread_local size_t s_spec_bytes = 0;
+
+thread_local Error s_errors[ErrorCapacity];
+thread_local size_t s_error_count = 0; /*< Every error of the parse, the ones after ErrorCapacity are not kept. */
+thread_local const char* s_value = nullptr; /*< The value taken last, a conversion of it reports to its definition. */
+thread_local size_t s_value_size = 0;
+thread_local size_t s_value_token = 0;
+thread_local size_t s_value_spec = 0;
+thread_local bool s_value_invalid = false; /*< The conversion of 's_value' recorded an InvalidValue. */
+thread_local size_t s_taken_spec = 0; /*< The definition of 's_taken'. */
+thread_local size_t s_help_flags = 0; /*< In the spec bytes. */
+thread_local size_t s_help_flags_size = 0;
+
+/* The candidates of the suggestions are collected from the definitions by the first lookup,
+ * and again only if the definitions change.
+ */
+thread_local Array<StringRef> s_suggest_flags = { nullptr, 0, 0 }; /*< The aliases of the flags. */
+thread_local Array<StringRef> s_suggest_words = { nullptr, 0, 0 }; /*< The subcommands and the choices. */
+thread_local size_t s_suggest_definitions = 0; /*< The s_definition_count the candidates are made of. */
+thread_local size_t s_suggest_choices = 0;
+thread_local size_t s_suggest_commands = 0;
+
+void write_stdout(void*, const char* data, size_t size)
+{
+    std::fwrite(data, 1, size, stdout);
+    std::fflush(stdout);
+}
+
+size_t help_width()
+{
+    if (s_width > 0)
+        return s_width;
+#if defined(TIOCGWINSZ)
+    struct winsize ws;
+    if (!ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) && ws.ws_col > 0)
+        return ws.ws_col;
+#endif // defined(TIOCGWINSZ)
+    const char* columns = std::getenv("COLUMNS");
+    const long width = columns ? std::strtol(columns, nullptr, 10) : 0;
+    return width > 0 ? width : 80;
+}
+
+/*! \brief Aliases of a flag spec, pointing into the spec */
+struct Aliases {
+    enum { Capacity = 16 };
+
+    struct Alias {
+        const char* data;
+        size_t size;
+    } items[Capacity];
+    size_t count;
+    bool value; /*< The spec has a value name after the last alias. */
+
+    bool contains(const Token& token) const
+    {
+        for (size_t i = 0; i < count; ++i) {
+            AP_COUNT(comparisons, 1);
+            if (token.prefix) {
+                if (items[i].size == 2 && items[i].data[0] == token.prefix && items[i].data[1] == token.data[0])
+                    return true;
+            } else if (token.size == items[i].size && !std::memcmp(token.data, items[i].data, token.size)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+const char* skip_spaces(const char* begin, const char* end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    return begin;
+}
+
+const char* trim_spaces(const char* begin, const char* end)
+{
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    return end;
+}
+
+/*! \brief Split the comma separated 'flags' and drop the value name after the last one */
+void separate_flags(const StringRef& flags, Aliases& aliases)
+{
+    const char* const end = flags.data + flags.size;
+    const char* begin = flags.data;
+    aliases.count = 0;
+    aliases.value = false;
+    while (aliases.count < Aliases::Capacity) {
+        const char* comma = std::find(begin, end, ',');
+        const char* first = skip_spaces(begin, comma);
+        const char* last = trim_spaces(first, comma);
+        if (comma == end) {
+            const char* space = last;
+            while (space > first && space[-1] != ' ' && space[-1] != '\t')
+                --space;
+            if (space > first) {
+                last = trim_spaces(first, space - 1);
+                aliases.value = true;
+            }
+        }
+        if (first < last) {
+            const Aliases::Alias alias = { first, size_t(last - first) };
+            aliases.items[aliases.count++] = alias;
+        }
+        if (comma == end)
+            break;
+        begin = comma + 1;
+    }
+}
+
+/*! \brief Copy 'bytes' to the spec bytes of the parse, return their offset
+ *
+ *  A copy is never split between the inline buffer and the rest, the inline buffer is left
+ *  with a gap instead.
+ */
+size_t copy_spec(const StringRef& bytes)
+{
+    if (s_spec_bytes < InlineSpecBytes && s_spec_bytes + bytes.size > InlineSpecBytes)
+        s_spec_bytes = InlineSpecBytes;
+    const size_t offset = s_spec_bytes;
+    if (offset < InlineSpecBytes)
+        std::memcpy(s_inline_spec_bytes + offset, bytes.data, bytes.size);
+    else
+        s_more_spec_bytes.append(bytes.data, bytes.size);
+    s_spec_bytes += bytes.size;
+    return offset;
+}
+
+/*! \brief Return the copied spec bytes of 'offset', valid until the spec bytes grow */
+StringRef spec_bytes(size_t offset, size_t size)
+{
+    return StringRef(offset < InlineSpecBytes ? s_inline_spec_bytes + offset : s_more_spec_bytes.data + offset - InlineSpecBytes, size);
+}
+
+/*! \brief Return the flags of the definition 'spec' (from 1) */
+StringRef definition_flags(size_t spec)
+{
+    const Definition& definition = spec <= InlineDefinitions ? s_inline_definitions[spec - 1] : s_more_definitions.data[spec - 1 - InlineDefinitions];
+    return spec_bytes(definition.flags, definition.size);
+}
+
+/*! \brief Record an error of 'token', of the definition 'spec' if it is not 0 */
+void add_error(ErrorCode code, size_t token, size_t spec)
+{
+    if (s_error_count < ErrorCapacity) {
+        Error& error = s_errors[s_error_count];
+        error.code = code;
+        error.token = token;
+        error.spec = spec;
+        error.flags = spec ? definition_flags(spec) : StringRef();
+    }
+    ++s_error_count;
+}
+
+/*! \brief Note a flag or argument definition, the errors of its values refer to it */
+void begin_spec(const StringRef& flags)
+{
+    const Definition definition = { copy_spec(flags), flags.size };
+    if (s_definition_count < InlineDefinitions)
+        s_inline_definitions[s_definition_count] = definition;
+    else
+        s_more_definitions.push_back(definition);
+    ++s_definition_count;
+}
+
+/*! \brief Remember the value taken from 'token', its conversion errors are recorded for it */
+void set_value(const StringRef& value, size_t token)
+{
+    s_value = value.data;
+    s_value_size = value.size;
+    s_value_token = token;
+    s_value_spec = s_definition_count;
+    s_value_invalid = false;
+}
+
+/*! \brief Record an error of a conversion, if 'str' is the value taken last */
+void value_error(ErrorCode code, const StringRef& str)
+{
+    if (s_value && str.data == s_value) {
+        add_error(code, s_value_token, s_value_spec);
+        s_value_invalid = s_value_invalid || code == ErrorCode::InvalidValue;
+    }
+}
+
+/*! \brief Start the errors of a new parse, 'argc' is set to 0 if argv is empty */
+void check_argv(int& argc, const char* const* argv)
+{
+    s_error_count = 0;
+    s_definition_count = 0;
+    s_more_definitions.size = 0;
+    s_spec_bytes = 0;
+    s_more_spec_bytes.size = 0;
+    s_choices.size = 0;
+    s_value = nullptr;
+    s_value_invalid = false;
+    s_value_spec = 0;
+    s_taken_spec = 0;
+    s_suggest_definitions = ~size_t(0);
+    if (argc < 1 || !argv || !argv[0]) {
+        add_error(ErrorCode::ArgvIsEmpty, 0, 0);
+        argc = 0;
+    }
+}
+
+/*! \brief Cut 'argc' to the arguments before a nullptr */
+void cut_argv(int& argc, const char* const* argv)
+{
+    for (int i = 1; i < argc; ++i)
+        if (!argv[i]) {
+            add_error(ErrorCode::ArgcExceedsArgv, 0, 0);
+            argc = i;
+            return;
+        }
+}
+
+/*! \brief Return true if only white space is left from 'end' */
+bool at_end(const char* end)
+{
+    while (*end && std::strchr(" \t\n\v\f\r", *end))
+        ++end;
+    return !*end;
+}
+
+/*! \brief Call 'visit' with each value of a comma separated list of choices */
+template <typename Visit>
+void for_each_choice(const char* data, size_t size, Visit visit)
+{
+    const char* const end = data + size;
+    for (const char* begin = data; begin < end;) {
+        const char* comma = std::find(begin, end, ',');
+        const char* first = skip_spaces(begin, comma);
+        const char* last = trim_spaces(first, comma);
+        if (first < last)
+            visit(StringRef(first, last - first));
+        begin = comma + 1;
+    }
+}
+
+/*! \brief Return true if 'a' and 'b' have a common alias */
+bool share_alias(const StringRef& a, const StringRef& b)
+{
+    Aliases first;
+    Aliases second;
+    separate_flags(a, first);
+    separate_flags(b, second);
+    for (size_t i = 0; i < first.count; ++i)
+        for (size_t j = 0; j < second.count; ++j)
+            if (first.items[i].size == second.items[j].size && !std::memcmp(first.items[i].data, second.items[j].data, first.items[i].size))
+                return true;
+    return false;
+}
+
+/*! \brief Check the value of the definition of 'flags' against its choices, and keep them for the suggestions
+ *
+ *  The flag has to be the last definition, ADD_CHOICES follows its PARSE_FLAG.
+ */
+void check_choices(const StringRef& flags, const StringRef& choices)
+{
+    const size_t spec = s_definition_count;
+    if (!spec || !share_alias(flags, definition_flags(spec)))
+        return;
+    const Choices noted = { spec, copy_spec(choices), choices.size };
+    s_choices.push_back(noted);
+
+    const size_t count = s_taken_spec == spec ? s_taken.size : s_value_spec == spec;
+    for (size_t i = 0; i < count; ++i) {
+        const StringRef value = s_taken_spec == spec ? StringRef(s_taken.data[i].data, s_taken.data[i].size) : StringRef(s_value, s_value_size);
+        bool found = false;
+        for_each_choice(choices.data, choices.size, [&](const StringRef& choice) { found = found || (choice.size == value.size && !std::memcmp(choice.data, value.data, value.size)); });
+        if (!found)
+            add_error(ErrorCode::InvalidChoice, s_taken_spec == spec ? s_taken_tokens.data[i] : s_value_token, spec);
+    }
+}
+
+/*! \brief Collect the candidates of the suggestions from the definitions, if they changed since the last time */
+void index_suggestions()
+{
+    if (s_suggest_definitions == s_definition_count && s_suggest_choices == s_choices.size && s_suggest_commands == s_commands.size)
+        return;
+    s_suggest_definitions = s_definition_count;
+    s_suggest_choices = s_choices.size;
+    s_suggest_commands = s_commands.size;
+    s_suggest_flags.size = 0;
+    s_suggest_words.size = 0;
+
+    Aliases aliases;
+    for (size_t i = 0; i <= s_definition_count; ++i) {
+        separate_flags(i ? definition_flags(i) : spec_bytes(s_help_flags, s_help_flags_size), aliases);
+        for (size_t j = 0; j < aliases.count; ++j)
+            s_suggest_flags.push_back(StringRef(aliases.items[j].data, aliases.items[j].size));
+    }
+    for (size_t i = 0; i < s_choices.size; ++i) {
+        const StringRef choices = spec_bytes(s_choices.data[i].data, s_choices.data[i].size);
+        for_each_choice(choices.data, choices.size, [](const StringRef& choice) { s_suggest_words.push_back(choice); });
+    }
+    for (size_t i = 0; i < s_commands.size; ++i)
+        s_suggest_words.push_back(StringRef(s_command_names.data + s_commands.data[i].name, s_commands.data[i].nameSize));
+}
+
+/*! \brief Return the Levenshtein distance of 'text' from a pattern, with Myers' bit-parallel algorithm
+ *
+ *  'peq' has a bit mask of the positions of each character in the pattern of 'size' characters
+ *  (at most 64). A column of the distance matrix is kept in two bit vectors of the vertical
+ *  differences, so a character of 'text' costs a few word operations.
+ */
+size_t edit_distance(const unsigned long long* peq, size_t size, const StringRef& text)
+{
+    const unsigned long long last = 1ull << (size - 1);
+    unsigned long long pv = ~0ull;
+    unsigned long long mv = 0;
+    size_t distance = size;
+    for (size_t i = 0; i < text.size; ++i) {
+        const unsigned long long eq = peq[static_cast<unsigned char>(text.data[i])];
+        const unsigned long long xv = eq | mv;
+        const unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+        unsigned long long ph = mv | ~(xh | pv);
+        unsigned long long mh = pv & xh;
+        if (ph & last)
+            ++distance;
+        else if (mh & last)
+            --distance;
+        // The first row is the distance from the empty pattern, it grows by one.
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return distance;
+}
+
+/*! \brief Return the size of the '-' and '+' characters starting a flag, at most two */
+size_t flag_prefix_size(const StringRef& flag)
+{
+    size_t size = 0;
+    while (size < 2 && size + 1 < flag.size && (flag.data[size] == '-' || flag.data[size] == '+'))
+        ++size;
+    return size;
+}
+
+/*! \brief The candidate closest to a word, of the ones it is shown
+ *
+ *  A third of the word (at least one character) may differ. The candidates with a length
+ *  out of that are not compared at all, and neither are they for a word under three or over
+ *  64 characters. The prefixes of flags are not compared, so '--zz' is not close to '--aa',
+ *  and a flag with a mistyped prefix only is close.
+ */
+struct Closest {
+    explicit Closest(const StringRef& word, bool flags = false)
+        : flags(flags)
+        , whole(word)
+        , prefix(flags ? flag_prefix_size(word) : 0)
+        , size(word.size - prefix)
+        , best(size < 3 || size > 64 ? 0 : (size + 2) / 3 + 1)
+    {
+        std::memset(peq, 0, sizeof(peq));
+        for (size_t i = 0; i < size && best; ++i)
+            peq[static_cast<unsigned char>(word.data[prefix + i])] |= 1ull << i;
+    }
+
+    void consider(const StringRef& candidate)
+    {
+        const size_t skip = flags ? flag_prefix_size(candidate) : 0;
+        const StringRef body(candidate.data + skip, candidate.size - skip);
+        if ((body.size > size ? body.size - size : size - body.size) >= best)
+            return;
+        if (candidate.size == whole.size && !std::memcmp(candidate.data, whole.data, whole.size))
+            return;
+        const size_t distance = edit_distance(peq, size, body);
+        if (distance < best) {
+            best = distance;
+            found = candidate;
+        }
+    }
+
+    void consider(const Array<StringRef>& candidates)
+    {
+        for (size_t i = 0; i < candidates.size; ++i)
+            consider(candidates.data[i]);
+    }
+
+    bool flags;
+    StringRef whole;
+    size_t prefix; /*< The flag prefix of 'whole', it is not compared. */
+    size_t size;
+    size_t best; /*< The distance of 'found', or the limit over it. */
+    unsigned long long peq[256];
+    StringRef found;
+};
+
+/* Out-of-range values are clamped and unreadable ones are kept, both are recorded as errors. */
+
+/*! \brief Return 'str' as a NUL-terminated string, copied into 'copy' if it is not terminated */
+const char* c_str(const StringRef& str, std::string& copy)
+{
+    if (!str.data[str.size])
+        return str.data;
+    copy.assign(str.data, str.size);
+    return copy.c_str();
+}
+
+template <typename T>
+void read_signed(const StringRef& str, T& value)
+{
+    AP_COUNT(conversions, 1);
+    AP_PHASE(conversion);
+    std::string copy;
+    const char* begin = c_str(str, copy);
+    char* end;
+    errno = 0;
+    const long long result = std::strtoll(begin, &end, 10);
+    if (end == begin || !at_end(end)) {
+        value_error(ErrorCode::InvalidValue, str);
+        return;
+    }
+    if (result < std::numeric_limits<T>::min())
+        value = std::numeric_limits<T>::min();
+    else if (result > std::numeric_limits<T>::max())
+        value = std::numeric_limits<T>::max();
+    else
+        value = result;
+    if (errno == ERANGE || value != result)
+        value_error(ErrorCode::ValueOutOfRange, str);
+}
+
+template <typename T>
+void read_unsigned(const StringRef& str, T& value)
+{
+    AP_COUNT(conversions, 1);
+    AP_PHASE(conversion);
+    std::string copy;
+    const char* begin = c_str(str, copy);
+    char* end;
+    errno = 0;
+    const unsigned long long result = std::strtoull(begin, &end, 10);
+    if (end == begin || !at_end(end)) {
+        value_error(ErrorCode::InvalidValue, str);
+        return;
+    }
+    // strtoull() negates a negative number, it is clamped to zero instead.
+    const bool negative = begin[std::strspn(begin, " \t\n\v\f\r")] == '-';
+    if (negative)
+        value = 0;
+    else if (result > std::numeric_limits<T>::max())
+        value = std::numeric_limits<T>::max();
+    else
+        value = result;
+    if (errno == ERANGE || (negative ? result != 0 : value != result))
+        value_error(ErrorCode::ValueOutOfRange, str);
+}
+
+template <typename T>
+void read_char(const StringRef& str, T& value)
+{
+    AP_COUNT(conversions, 1);
+    for (size_t i = 0; i < str.size; ++i)
+        if (!std::strchr(" \t\n\v\f\r", str.data[i])) {
+            value = str.data[i];
+            return;
+        }
+    value_error(ErrorCode::InvalidValue, str);
+}
+
+template <typename T>
+void read_float(T (*convert)(const char*, char**), const StringRef& str, T& value)
+{
+    AP_COUNT(conversions, 1);
+    AP_PHASE(conversion);
+    std::string copy;
+    const char* begin = c_str(str, copy);
+    char* end;
+    errno = 0;
+    const T result = convert(begin, &end);
+    if (end == begin || !at_end(end)) {
+        value_error(ErrorCode::InvalidValue, str);
+        return;
+    }
+    value = result;
+    // An underflow is rounded towards zero, only an overflow is out of range. It is clamped to
+    // the largest finite value instead of the infinity of the conversion.
+    if (errno == ERANGE && (result > T(1) || result < T(-1))) {
+        value = result > T(0) ? std::numeric_limits<T>::max() : -std::numeric_limits<T>::max();
+        value_error(ErrorCode::ValueOutOfRange, str);
+    }
+}
+
+template <typename T>
+std::string format_float(const char* format, T value)
+{
+    char buffer[64];
+    const int size = std::snprintf(buffer, sizeof(buffer), format, value);
+    return std::string(buffer, size > 0 ? size : 0);
+}
+
+/*! \brief FNV-1a hash of a command name */
+size_t hash_name(const char* data, size_t size)
+{
+    size_t hash = size_t(14695981039346656037ull);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * size_t(1099511628211ull);
+    return hash;
+}
+
+/*! \brief Return 1 + the index of the command named 'data', or 0 */
+size_t lookup_command(const char* data, size_t size)
+{
+    if (!s_command_slots.size)
+        return 0;
+    const size_t mask = s_command_slots.size - 1;
+    for (size_t slot = hash_name(data, size) & mask; s_command_slots.data[slot]; slot = (slot + 1) & mask) {
+        const Command& command = s_commands.data[s_command_slots.data[slot] - 1];
+        if (command.nameSize == size && !std::memcmp(s_command_names.data + command.name, data, size))
+            return s_command_slots.data[slot];
+    }
+    return 0;
+}
+
+/*! \brief Insert the last command into the hash table, which is kept at most half full */
+void index_last_command()
+{
+    if (2 * s_commands.size > s_command_slots.size) {
+        const size_t slots = std::max(size_t(16), 2 * s_command_slots.size);
+        s_command_slots.reserve(slots);
+        s_command_slots.size = slots;
+        std::memset(s_command_slots.data, 0, slots * sizeof(size_t));
+        for (size_t i = 0; i + 1 < s_commands.size; ++i) {
+            const Command& command = s_commands.data[i];
+            size_t slot = hash_name(s_command_names.data + command.name, command.nameSize) & (slots - 1);
+            while (s_command_slots.data[slot])
+                slot = (slot + 1) & (slots - 1);
+            s_command_slots.data[slot] = i + 1;
+        }
+    }
+    const Command& command = s_commands.data[s_commands.size - 1];
+    const char* const name = s_command_names.data + command.name;
+    if (lookup_command(name, command.nameSize))
+        return; // The first one of the same name is called.
+    const size_t mask = s_command_slots.size - 1;
+    size_t slot = hash_name(name, command.nameSize) & mask;
+    while (s_command_slots.data[slot])
+        slot = (slot + 1) & mask;
+    s_command_slots.data[slot] = s_commands.size;
+}
+
+inline bool is_used(size_t i)
+{
+    return s_tokens.data[i].used == s_parse;
+}
+
+inline size_t& next_of(size_t i)
+{
+    return s_token_index.data[s_token_slots + 2 * i];
+}
+
+inline size_t& home_of(size_t i)
+{
+    return s_token_index.data[s_token_slots + 2 * i + 1];
+}
+
+/*! \brief Return the slot of the tokens with the text 'data', or the empty slot where they would be */
+size_t token_slot(const char* data, size_t size)
+{
+    const size_t mask = s_token_slots - 1;
+    size_t slot = hash_name(data, size) & mask;
+    while (const size_t i = s_token_index.data[slot]) {
+        if (i != Tombstone && s_tokens.data[i].size == size && !std::memcmp(s_tokens.data[i].data, data, size))
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/*! \brief Return the row of a short flag prefix in 's_short_first', or -1 */
+inline int short_row(char prefix)
+{
+    return int(s_short_row[static_cast<unsigned char>(prefix)]) - 1;
+}
+
+/*! \brief Return the home of the tokens of an alias: its slot, or s_token_slots + its entry in the short flag table */
+size_t alias_home(const char* data, size_t size)
+{
+    const int row = size == 2 ? short_row(data[0]) : -1;
+    if (row >= 0)
+        return s_token_slots + 256 * row + static_cast<unsigned char>(data[1]);
+    return token_slot(data, size);
+}
+
+/*! \brief Return the home of the text of 'token', see alias_home() */
+size_t token_home(const Token& token)
+{
+    if (token.prefix)
+        return s_token_slots + 256 * short_row(token.prefix) + static_cast<unsigned char>(token.data[0]);
+    return alias_home(token.data, token.size);
+}
+
+/*! \brief Return the first token at 'home' */
+size_t& head_at(size_t home)
+{
+    if (home < s_token_slots)
+        return s_token_index.data[home];
+    return s_short_first[(home - s_token_slots) / 256][(home - s_token_slots) % 256];
+}
+
+size_t& alias_first(const char* data, size_t size)
+{
+    return head_at(alias_home(data, size));
+}
+
+/*! \brief Chain the tokens of the same text in increasing order, in a hash table of the texts
+ *
+ *  It is built at the first flag lookup of a parse, so a parse without flags does not pay
+ *  for it, and then every lookup is independent of the number of tokens.
+ */
+void index_tokens()
+{
+    AP_PHASE(tokenize);
+    s_token_slots = 16;
+    while (s_token_slots < 2 * s_tokens.size)
+        s_token_slots *= 2;
+    s_token_index.reserve(s_token_slots + 2 * s_tokens.size);
+    s_token_index.size = s_token_slots + 2 * s_tokens.size;
+    std::memset(s_token_index.data, 0, s_token_slots * sizeof(size_t));
+    std::memset(s_short_first, 0, s_short_rows * sizeof(s_short_first[0]));
+    s_token_tombstones = 0;
+    for (size_t i = s_tokens.size; i-- > 1;) {
+        const size_t home = token_home(s_tokens.data[i]);
+        size_t& first = head_at(home);
+        next_of(i) = first;
+        home_of(i) = home;
+        first = i;
+    }
+    s_tokens_indexed = true;
+}
+
+/*! \brief Skip the used tokens at the front of a chain for good
+ *
+ *  The last one is kept to keep the probe sequences of the table. The skips of a parse
+ *  started by parse_edit() are logged, the next edit undoes them.
+ */
+void skip_used(size_t& first)
+{
+    const size_t original = first;
+    while (first && is_used(first) && next_of(first)) {
+        AP_COUNT(tokensScanned, 1);
+        first = next_of(first);
+    }
+    if (s_incremental && first != original) {
+        const Compression compression = { &first, original };
+        s_compressions.push_back(compression);
+    }
+}
+
+/*! \brief Return the first unused token of an alias before 'end', or 0 */
+size_t find_alias(const char* data, size_t size, size_t end)
+{
+    AP_COUNT(comparisons, 1);
+    size_t& first = alias_first(data, size);
+    skip_used(first);
+    return first && !is_used(first) && first < end ? first : 0;
+}
+
+/*! \brief Return the end of the tokens of the program, the first one naming a subcommand
+ *
+ *  It is searched again only after new commands, with one hash lookup per token. Only the
+ *  whole arguments can name a command, not the parts of a split one.
+ */
+size_t parse_end()
+{
+    if (!s_commands_changed)
+        return s_end;
+    s_commands_changed = false;
+    s_end = s_tokens.size;
+    s_end_unused = 0;
+    int arg = 0;
+    for (size_t i = 1; i < s_tokens.size; ++i) {
+        const Token& previous = s_tokens.data[i - 1];
+        if (previous.data[previous.size])
+            continue;
+        ++arg;
+        const Token& token = s_tokens.data[i];
+        if (is_used(i) || token.data[token.size])
+            continue;
+        if (const size_t command = lookup_command(token.data, token.size)) {
+            s_end = i;
+            s_command = command - 1;
+            s_command_arg = arg;
+            break;
+        }
+    }
+    for (size_t i = s_end; i < s_tokens.size; ++i)
+        s_end_unused += !is_used(i);
+    return s_end;
+}
+
+/*! \brief Map the characters of 's_short_flag_prefixes' to their rows, if it is changed */
+void setup_short_prefixes()
+{
+    if (s_short_prefixes_of_rows == s_short_flag_prefixes)
+        return;
+    std::memset(s_short_row, 0, sizeof(s_short_row));
+    s_short_rows = 0;
+    for (const char* prefix = s_short_flag_prefixes; *prefix && s_short_rows < ShortPrefixCapacity; ++prefix)
+        if (!s_short_row[static_cast<unsigned char>(*prefix)])
+            s_short_row[static_cast<unsigned char>(*prefix)] = ++s_short_rows;
+    s_short_prefixes_of_rows = s_short_flag_prefixes;
+}
+
+/*! \brief Add a token, or a token per character of a bundle of short flags like '-xvf'
+ *
+ *  A bundle starts with a short flag prefix not doubled, and it is not a negative number.
+ */
+void push_token(Array<Token>& tokens, const char* data, size_t size)
+{
+    const char first = size > 2 ? data[1] : '\0';
+    if (first && short_row(data[0]) >= 0 && first != data[0] && (first < '0' || first > '9') && first != '.') {
+        for (size_t i = 1; i < size; ++i) {
+            const Token token = { data + i, 1, 0, data[0] };
+            tokens.push_back(token);
+        }
+        return;
+    }
+    const Token token = { data, size, 0, '\0' };
+    tokens.push_back(token);
+}
+
+/*! \brief Add the tokens of an argument, split at 's_long_flag_delimiter'
+ *
+ *  The bundles of short flags are split too, if 's_short_flag_prefixes' is set.
+ */
+void push_argument(Array<Token>& tokens, const char* arg)
+{
+    const size_t pos = std::strcspn(arg, s_long_flag_delimiter);
+    push_token(tokens, arg, pos);
+    if (arg[pos]) {
+        const Token value = { arg + pos + 1, std::strlen(arg + pos + 1), 0, '\0' };
+        tokens.push_back(value);
+    }
+}
+
+/*! \brief Start a new parse of the tokens of 'argv', none of them is used */
+void restart_parse(int argc, const char* const* argv)
+{
+    s_unused = s_tokens.size ? s_tokens.size - 1 : 0;
+    s_next_arg = 1;
+    s_argc = argc;
+    s_argv = argv;
+    s_commands.size = 0;
+    s_command_names.size = 0;
+    s_command_slots.size = 0;
+    s_commands_changed = false;
+    s_end = s_tokens.size;
+    s_end_unused = 0;
+}
+
+/*! \brief Point the tokens to 'argv', see push_argument() */
+void setup_argv(int argc, const char* const* argv)
+{
+    AP_PHASE(tokenize);
+    setup_short_prefixes();
+    s_tokens.size = 0;
+    s_tokens.reserve(2 * size_t(argc > 0 ? argc : 0));
+    if (argc > 0) {
+        const Token program = { argv[0], std::strlen(argv[0]), 0, '\0' };
+        s_tokens.push_back(program);
+    }
+    for (int i = 1; i < argc; ++i)
+        push_argument(s_tokens, argv[i]);
+    s_tokens_indexed = false;
+    restart_parse(argc, argv);
+}
+
+void use_token(size_t i)
+{
+    s_tokens.data[i].used = s_parse;
+    --s_unused;
+    while (s_next_arg < s_tokens.size && is_used(s_next_arg))
+        ++s_next_arg;
+}
+
+/*! \brief Return the index of the first unused token matching any of 'flags', or 0 */
+size_t find_token(const StringRef& flags)
+{
+    if (!s_tokens_indexed && s_tokens.size > s_index_min_tokens)
+        index_tokens();
+    AP_PHASE(lookup);
+    Aliases aliases;
+    separate_flags(flags, aliases);
+    const size_t end = parse_end();
+    if (!s_tokens_indexed) {
+        for (size_t i = s_next_arg; i < end; ++i) {
+            AP_COUNT(tokensScanned, 1);
+            if (!is_used(i) && aliases.contains(s_tokens.data[i]))
+                return i;
+        }
+        return 0;
+    }
+    size_t found = 0;
+    for (size_t i = 0; i < aliases.count; ++i) {
+        const size_t token = find_alias(aliases.items[i].data, aliases.items[i].size, found ? found : end);
+        if (token)
+            found = token;
+    }
+    return found;
+}
+
+size_t find_flag(const StringRef& flags)
+{
+    AP_COUNT(definedFlags, 1);
+    begin_spec(flags);
+    return find_token(flags);
+}
+
+/*! \brief Return the first unused token after 'i', or 's_end' */
+size_t next_unused(size_t i)
+{
+    size_t j = i + 1;
+    while (j < s_end && is_used(j))
+        ++j;
+    return j;
+}
+
+/*! \brief Return true if the token after 'i' is the next unused character of the same bundle */
+bool continues_bundle(size_t i)
+{
+    return i + 1 < s_end && s_tokens.data[i + 1].prefix && s_tokens.data[i + 1].data == s_tokens.data[i].data + 1 && !is_used(i + 1);
+}
+
+/*! \brief Consume the flag token 'i' and the argument after it, see take_flag()
+ *
+ *  A short flag with a value has to be the last one of its bundle. If the value is a bundle
+ *  of short flags itself, it is the whole argument (the rest of it, if some were used).
+ */
+bool take_flag_value(size_t i, StringRef& value)
+{
+    if (!i)
+        return false;
+    const bool bundled = s_tokens.data[i].prefix && continues_bundle(i);
+    const size_t j = bundled ? i : next_unused(i);
+    AP_COUNT(tokensScanned, j - i);
+    if (bundled || j >= s_end) {
+        add_error(ErrorCode::MissingValue, i, s_definition_count);
+        return false;
+    }
+    const Token& token = s_tokens.data[j];
+    const char* const begin = token.prefix && (j == i + 1 || !continues_bundle(j - 1)) && token.data[-1] == token.prefix ? token.data - 1 : token.data;
+    use_token(i);
+    use_token(j);
+    size_t last = j;
+    while (token.prefix && continues_bundle(last))
+        use_token(++last);
+    value = StringRef(begin, s_tokens.data[last].data + s_tokens.data[last].size - begin);
+    set_value(value, j);
+    return true;
+}
+
+void add_help_entry(const std::string& spec, const std::string& text)
+{
+    const HelpEntry entry = { s_help_buffer.size, spec.size(), s_help_buffer.size + spec.size(), text.size() };
+    s_help_buffer.append(spec.data(), spec.size());
+    s_help_buffer.append(text.data(), text.size());
+    s_help_entries.push_back(entry);
+    if (spec.size() > s_help_longest_spec)
+        s_help_longest_spec = spec.size();
+}
+
+void add_help_text(const std::string& text)
+{
+    add_help_entry(std::string(), text);
+}
+
+void clear_help()
+{
+    s_help_entries.size = 0;
+    s_help_buffer.size = 0;
+    s_help_longest_spec = 0;
+}
+
+bool starts_with(const char* data, size_t size, const char* prefix, size_t prefixSize)
+{
+    return size >= prefixSize && !std::memcmp(data, prefix, prefixSize);
+}
+
+/*! \brief Add a candidate of the completion, the '--flag=' of the completed word and 'data' if 'lead' */
+void add_candidate(const char* data, size_t size, bool lead)
+{
+    if (!starts_with(data, size, s_complete_word, s_complete_word_size))
+        return;
+    const size_t leadSize = lead ? s_complete_lead : 0;
+    const HelpEntry entry = { s_help_buffer.size, leadSize + size, 0, 0 };
+    s_help_buffer.append(s_complete_word - s_complete_lead, leadSize);
+    s_help_buffer.append(data, size);
+    s_help_entries.push_back(entry);
+}
+
+/*! \brief Collect the aliases of a flag, or 'choices' if the completed value belongs to the flag
+ *
+ *  Without 'choices' the flag is a definition, its spec has to have a value name for it to
+ *  take the completed value. The aliases collected before that flag are dropped.
+ */
+void complete_flag(const Aliases& aliases, const StringRef* choices)
+{
+    bool owner = false;
+    for (size_t i = 0; s_complete_flag && (choices || aliases.value) && i < aliases.count; ++i)
+        owner = owner || (aliases.items[i].size == s_complete_flag_size && !std::memcmp(aliases.items[i].data, s_complete_flag, s_complete_flag_size));
+    if (owner && !s_complete_values) {
+        clear_help();
+        s_complete_values = true;
+    }
+    if (owner && choices) {
+        const char* const end = choices->data + choices->size;
+        for (const char* begin = choices->data; begin < end;) {
+            const char* comma = std::find(begin, end, ',');
+            const char* first = skip_spaces(begin, comma);
+            add_candidate(first, trim_spaces(first, comma) - first, true);
+            begin = comma + 1;
+        }
+    } else if (!choices && !s_complete_values && s_complete_word_size && spec::is_prefix(s_complete_word[0])) {
+        for (size_t i = 0; i < aliases.count; ++i)
+            add_candidate(aliases.items[i].data, aliases.items[i].size, false);
+    }
+}
+
+bool is_delimiter(const char* word)
+{
+    return word[0] && !word[1] && std::strchr(s_long_flag_delimiter, word[0]);
+}
+
+/*! \brief Start the completion mode if argv is a query, then point 'argc' and 'argv' to the words before the completed one
+ *
+ *  The value of a flag is completed after the flag, after its delimiter in the same word, or
+ *  after the delimiter as a separate word, which is how bash splits '--flag=value'.
+ */
+bool setup_completion(int& argc, const char* const*& argv)
+{
+    if (s_complete_nested) {
+        s_complete_nested = false;
+        return true;
+    }
+    s_complete_word = "";
+    s_complete_lead = 0;
+    s_complete_flag = nullptr;
+    s_complete_flag_size = 0;
+    s_complete_delimited = false;
+    s_complete_shell = nullptr;
+    if (argc == 3 && !std::strcmp(argv[1], "--ap-completion")) {
+        s_complete_shell = argv[2];
+        s_complete_delimited = true;
+        argc = 1;
+    } else if (argc >= 4 && !std::strcmp(argv[1], "--ap-complete") && !std::strcmp(argv[3], "--")) {
+        const int words = argc - 4;
+        const long cword = std::strtol(argv[2], nullptr, 10);
+        argc = cword > 0 && cword < words ? int(cword) : words;
+        argv += 4;
+        const char* word = argc < words ? argv[argc] : "";
+        const char* previous = argc > 1 ? argv[argc - 1] : "";
+        const size_t pos = spec::is_prefix(word[0]) ? std::strcspn(word, s_long_flag_delimiter) : 0;
+        if (is_delimiter(word)) {
+            s_complete_flag = previous;
+            s_complete_delimited = true;
+            word = "";
+        } else if (is_delimiter(previous) && argc > 2) {
+            s_complete_flag = argv[argc - 2];
+            s_complete_delimited = true;
+        } else if (pos && word[pos]) {
+            s_complete_flag = word;
+            s_complete_flag_size = pos;
+            s_complete_lead = pos + 1;
+            s_complete_delimited = true;
+        } else if (spec::is_prefix(previous[0])) {
+            s_complete_flag = previous;
+        }
+        if (s_complete_flag && !s_complete_flag_size)
+            s_complete_flag_size = std::strlen(s_complete_flag);
+        s_complete_word = word + s_complete_lead;
+    } else {
+        return false;
+    }
+    s_complete_word_size = std::strlen(s_complete_word);
+    s_complete_values = s_complete_delimited;
+    return true;
+}
+
+/*! \brief Write the sorted and distinct candidates of the completion into 'page', a line each */
+void layout_completion(std::string& page)
+{
+    const char* const buffer = s_help_buffer.data;
+    HelpEntry* const begin = s_help_entries.data;
+    HelpEntry* const end = begin + s_help_entries.size;
+    struct {
+        const char* buffer;
+        int compare(const HelpEntry& a, const HelpEntry& b) const
+        {
+            const int result = std::memcmp(buffer + a.spec, buffer + b.spec, std::min(a.specSize, b.specSize));
+            return result ? result : int(a.specSize > b.specSize) - int(a.specSize < b.specSize);
+        }
+        bool operator()(const HelpEntry& a, const HelpEntry& b) const { return compare(a, b) < 0; }
+    } less = { buffer };
+    std::sort(begin, end, less);
+    for (HelpEntry* entry = begin; entry < end; ++entry)
+        if (entry == begin || less.compare(entry[-1], *entry))
+            page.append(buffer + entry->spec, entry->specSize).push_back('\n');
+    clear_help();
+}
+
+/*! \brief Map every argument to its first token, a token ends its argument if it ends with NUL */
+void map_arguments()
+{
+    s_arg_tokens.size = 0;
+    s_arg_tokens.reserve(size_t(s_argc) + 1);
+    for (size_t i = 0; i < s_tokens.size; ++i)
+        if (!i || !s_tokens.data[i - 1].data[s_tokens.data[i - 1].size])
+            s_arg_tokens.push_back(i);
+    s_arg_tokens.push_back(s_tokens.size);
+}
+
+/*! \brief Remove the token 'i' from the chain of its text, an emptied slot becomes a Tombstone */
+void unlink_token(size_t i)
+{
+    size_t& first = head_at(home_of(i));
+    if (first != i) {
+        size_t previous = first;
+        while (next_of(previous) != i)
+            previous = next_of(previous);
+        next_of(previous) = next_of(i);
+    } else if (next_of(i) || home_of(i) >= s_token_slots) {
+        first = next_of(i);
+    } else {
+        first = Tombstone;
+        ++s_token_tombstones;
+    }
+}
+
+/*! \brief Insert the token 'i' into the chain of its text, in increasing order */
+void link_token(size_t i)
+{
+    const size_t home = token_home(s_tokens.data[i]);
+    size_t& first = head_at(home);
+    home_of(i) = home;
+    if (!first || first > i) {
+        next_of(i) = first;
+        first = i;
+        return;
+    }
+    size_t previous = first;
+    while (next_of(previous) && next_of(previous) < i)
+        previous = next_of(previous);
+    next_of(i) = next_of(previous);
+    next_of(previous) = i;
+}
+
+/*! \brief Renumber the links to the tokens from 'from', they are moved to 'to' */
+void renumber_links(size_t from, size_t to)
+{
+    for (size_t slot = 0; slot < s_token_slots; ++slot)
+        if (s_token_index.data[slot] != Tombstone && s_token_index.data[slot] >= from)
+            s_token_index.data[slot] += to - from;
+    for (size_t row = 0; row < s_short_rows; ++row)
+        for (size_t c = 0; c < 256; ++c)
+            if (s_short_first[row][c] >= from)
+                s_short_first[row][c] += to - from;
+    for (size_t i = 1; i < s_tokens.size; ++i)
+        if (next_of(i) >= from)
+            next_of(i) += to - from;
+}
+
+/*! \brief Replace the tokens of the 'removed' arguments from 'first' with the ones of the new arguments of 'argv'
+ *
+ *  Only the chains of the removed and the new tokens are walked, and the skips of the last
+ *  parse are undone from their log. If the number of tokens changes, the later tokens are
+ *  moved and the links to them are renumbered. Return false if the edit does not fit the
+ *  last parse, then argv has to be parsed again.
+ */
+bool edit_argv(int argc, const char* const* argv, size_t first, size_t removed)
+{
+    const size_t oldArgc = size_t(s_argc);
+    if (!s_incremental || s_short_prefixes_of_rows != s_short_flag_prefixes || !first || first + removed > oldArgc || size_t(argc) + removed < oldArgc)
+        return false;
+    // A nullptr among the new arguments cuts argv, that needs a full parse.
+    const size_t added = size_t(argc) + removed - oldArgc;
+    for (size_t i = first; i < first + added; ++i)
+        if (!argv[i])
+            return false;
+    AP_PHASE(tokenize);
+    while (s_compressions.size) {
+        const Compression& compression = s_compressions.data[--s_compressions.size];
+        *compression.head = compression.first;
+    }
+    const size_t begin = s_arg_tokens.data[first];
+    const size_t end = s_arg_tokens.data[first + removed];
+    for (size_t i = begin; i < end; ++i)
+        unlink_token(i);
+
+    // The arguments after the edit keep their tokens, the new ones are split.
+    s_arg_tokens.reserve(size_t(argc) + 1);
+    std::memmove(s_arg_tokens.data + first + added, s_arg_tokens.data + first + removed, (oldArgc + 1 - first - removed) * sizeof(size_t));
+    s_arg_tokens.size = size_t(argc) + 1;
+    s_edit_tokens.size = 0;
+    for (size_t i = 0; i < added; ++i) {
+        s_arg_tokens.data[first + i] = begin + s_edit_tokens.size;
+        push_argument(s_edit_tokens, argv[first + i]);
+    }
+    const size_t newEnd = begin + s_edit_tokens.size;
+    const size_t oldSize = s_tokens.size;
+    const size_t size = oldSize - end + newEnd;
+    if (newEnd != end)
+        for (size_t i = first + added; i < s_arg_tokens.size; ++i)
+            s_arg_tokens.data[i] += newEnd - end;
+
+    s_tokens.reserve(size);
+    std::memmove(s_tokens.data + newEnd, s_tokens.data + end, (oldSize - end) * sizeof(Token));
+    std::memcpy(s_tokens.data + begin, s_edit_tokens.data, s_edit_tokens.size * sizeof(Token));
+    s_tokens.size = size;
+    if (2 * (size + s_token_tombstones) > s_token_slots) {
+        index_tokens();
+        return true;
+    }
+    s_token_index.reserve(s_token_slots + 2 * size);
+    size_t* const links = s_token_index.data + s_token_slots;
+    std::memmove(links + 2 * newEnd, links + 2 * end, 2 * (oldSize - end) * sizeof(size_t));
+    s_token_index.size = s_token_slots + 2 * size;
+    if (newEnd != end && end < oldSize)
+        renumber_links(end, newEnd);
+    for (size_t i = begin; i < newEnd; ++i)
+        link_token(i);
+    return true;
+}
+
+/*! \brief Return true if an argument is one of 'flags', like check_flag() but from the token index */
+bool has_argument(const StringRef& flags)
+{
+    Aliases aliases;
+    separate_flags(flags, aliases);
+    for (size_t a = 0; a < aliases.count; ++a)
+        for (size_t i = alias_first(aliases.items[a].data, aliases.items[a].size); i; i = next_of(i)) {
+            const Token& token = s_tokens.data[i];
+            const Token& previous = s_tokens.data[i - 1];
+            if (!token.prefix && !token.data[token.size] && !previous.data[previous.size])
+                return true;
+        }
+    return false;
+}
+
+/*! \brief Write the help page which is not flushed, to stdout if it answers a completion query */
+void flush_pending_help()
+{
+    if (!s_help_pending)
+        return;
+    const Writer out = s_complete ? Writer({ write_stdout, nullptr }) : s_help_out;
+    std::string page;
+    if (take_help_page(page))
+        out.write(out.context, page.data(), page.size());
+}
+
+void flush_help_at_exit()
+{
+    flush_pending_help();
+}
+
+/*! \brief Start collecting the help if 'help', after the tokens are set up */
+bool start_parse(const StringRef& flags, const StringRef& msg, const StringRef& usage, bool help, const Writer& out)
+{
+    // Only the thread calling exit() is flushed by it, the others by their next parse.
+    static const int atexitRegistered = std::atexit(flush_help_at_exit);
+    (void)atexitRegistered;
+    s_help = help;
+    s_help_pending = help;
+    s_help_out = out;
+    s_help_flags = copy_spec(flags);
+    s_help_flags_size = flags.size;
+    if (s_help) {
+        AP_PHASE(help);
+        Aliases aliases;
+        separate_flags(flags, aliases);
+        s_help_token = 1;
+        while (s_help_token < s_tokens.size && !aliases.contains(s_tokens.data[s_help_token]))
+            ++s_help_token;
+        if (!s_complete)
+            add_help_text(expand_patterns(usage, ""));
+        add_flag_help(flags, format_value(s_help), msg);
+    } else {
+        AP_COUNT(definedFlags, 1);
+    }
+    AP_COUNT(parsedFlags, s_help);
+    return s_help;
+}
+
+} // namespace anonymous
+
+thread_local bool s_help = false;
+thread_local bool s_complete = false;
+int s_alignment = 0;
+int s_width = 0;
+const char* s_short_flag_prefixes = "";
+const char* s_long_flag_delimiter = "=";
+Writer s_stdout = { write_stdout, nullptr };
+
+bool parse_help(const StringRef& flags, const StringRef& msg, const StringRef& usage, int argc, const char* const* argv, const Writer& out)
+{
+    flush_pending_help();
+    AP_RESET_STATS();
+    check_argv(argc, argv);
+    cut_argv(argc, argv);
+    s_complete = setup_completion(argc, argv);
+    s_incremental = false;
+    setup_argv(argc, argv);
+    return start_parse(flags, msg, usage, s_complete || check_flag(flags, argc, argv), out);
+}
+
+bool parse_edit(const StringRef& flags, const StringRef& msg, const StringRef& usage, int argc, const char* const* argv, size_t first, size_t removed, const Writer& out)
+{
+    flush_pending_help();
+    AP_RESET_STATS();
+    check_argv(argc, argv);
+    if (edit_argv(argc, argv, first, removed)) {
+        restart_parse(argc, argv);
+    } else {
+        cut_argv(argc, argv);
+        setup_argv(argc, argv);
+        index_tokens();
+        map_arguments();
+        s_compressions.size = 0;
+    }
+    if (!++s_parse) {
+        for (size_t i = 0; i < s_tokens.size; ++i)
+            s_tokens.data[i].used = 0;
+        s_parse = 1;
+    }
+    s_complete = false;
+    s_incremental = true;
+    return start_parse(flags, msg, usage, has_argument(flags), out);
+}
+
+bool parse_flag(const StringRef& flags, bool value, const StringRef& msg)
+{
+    if (s_help) {
+        add_flag_help(flags, format_value(value), msg);
+        return value;
+    }
+
+    if (const size_t i = find_flag(flags)) {
+        use_token(i);
+        AP_COUNT(parsedFlags, 1);
+        return !value;
+    }
+    return value;
+}
+
+bool bind_flag(const StringRef& flags, bool* value, const StringRef& msg)
+{
+    const bool given = parse_flag(flags, *value, msg) != *value;
+    *value = *value != given;
+    return given;
+}
+
+bool parse_bootstrap_flag(const StringRef& flags, bool value, const StringRef& msg)
+{
+    if (s_help)
+        add_flag_help(flags, format_value(value), msg);
+    else
+        AP_COUNT(definedFlags, 1);
+
+    begin_spec(flags);
+    if (const size_t i = find_token(flags)) {
+        use_token(i);
+        AP_COUNT(parsedFlags, 1);
+        return !value;
+    }
+    return value;
+}
+
+size_t count_flag(const StringRef& flags, const StringRef& msg)
+{
+    if (s_help) {
+        add_flag_help(flags, "0", msg);
+        return 0;
+    }
+    return take_flags(flags, false);
+}
+
+bool has_flag(const StringRef& flags)
+{
+    return find_token(flags);
+}
+
+void add_msg(const StringRef& msg)
+{
+    if (s_help && !s_complete) {
+        AP_PHASE(help);
+        add_help_text(expand_patterns(msg, ""));
+    }
+}
+
+size_t unparsed_count()
+{
+    parse_end();
+    return s_unused - s_end_unused;
+}
+
+size_t finish_parse()
+{
+    // The help mode parses no flag, so the arguments are not unparsed ones.
+    if (s_help)
+        return s_error_count;
+    const size_t end = parse_end();
+    for (size_t i = s_next_arg; i < end; ++i) {
+        if (is_used(i))
+            continue;
+        const Token& token = s_tokens.data[i];
+        const Token& previous = s_tokens.data[i - 1];
+        // The value joined to an unknown flag with the delimiter belongs to its error.
+        if (!token.prefix && !previous.prefix && !is_used(i - 1) && previous.data[previous.size])
+            continue;
+        // A known flag without its value is reported already.
+        bool reported = false;
+        for (size_t e = 0; e < std::min(s_error_count, ErrorCapacity) && !reported; ++e)
+            reported = s_errors[e].code == ErrorCode::MissingValue && s_errors[e].token == i;
+        if (reported)
+            continue;
+        const bool flag = token.prefix || (token.size > 1 && (token.data[0] == '-' || short_row(token.data[0]) >= 0) && !std::isdigit(static_cast<unsigned char>(token.data[1])) && token.data[1] != '.');
+        add_error(flag ? ErrorCode::UnknownFlag : ErrorCode::UnexpectedArgument, i, 0);
+    }
+    return s_error_count;
+}
+
+size_t error_count()
+{
+    return s_error_count;
+}
+
+const Error& error_at(size_t i)
+{
+    // The spec bytes may have grown since the error was recorded.
+    Error& error = s_errors[i];
+    error.flags = error.spec ? definition_flags(error.spec) : StringRef();
+    return error;
+}
+
+void format_error(const Error& error, std::string& text)
+{
+    static const char* const messages[] = { "argv is empty", "argv ends before argc", "missing value of", "invalid value", "value out of range", "invalid choice", "unknown flag", "unexpected argument" };
+    text += messages[static_cast<int>(error.code)];
+    if (error.token && error.token < s_tokens.size) {
+        const Token& token = s_tokens.data[error.token];
+        text += " '";
+        if (token.prefix)
+            text += token.prefix;
+        text.append(token.data, token.size);
+        text += '\'';
+    }
+    const StringRef flags = error.spec && error.spec <= s_definition_count ? definition_flags(error.spec) : StringRef();
+    if (flags.size && (error.code == ErrorCode::InvalidValue || error.code == ErrorCode::ValueOutOfRange || error.code == ErrorCode::InvalidChoice)) {
+        text += " of '";
+        text.append(flags.data, flags.size);
+        text += '\'';
+    }
+    const StringRef suggestion = suggest(error);
+    if (suggestion.size) {
+        text += ", did you mean '";
+        text.append(suggestion.data, suggestion.size);
+        text += "'?";
+    }
+}
+
+StringRef suggest(const Error& error)
+{
+    if (!error.token || error.token >= s_tokens.size)
+        return StringRef();
+    const Token& token = s_tokens.data[error.token];
+    const StringRef word(token.data, token.size);
+    Closest closest(word, error.code == ErrorCode::UnknownFlag);
+    if (error.code == ErrorCode::InvalidChoice) {
+        // The choices of one flag are few, they are not indexed.
+        for (size_t i = 0; i < s_choices.size; ++i)
+            if (s_choices.data[i].spec == error.spec) {
+                const StringRef choices = spec_bytes(s_choices.data[i].data, s_choices.data[i].size);
+                for_each_choice(choices.data, choices.size, [&](const StringRef& choice) { closest.consider(choice); });
+            }
+    } else if (error.code == ErrorCode::UnknownFlag && !token.prefix) {
+        index_suggestions();
+        closest.consider(s_suggest_flags);
+    } else if (error.code == ErrorCode::UnexpectedArgument) {
+        index_suggestions();
+        closest.consider(s_suggest_words);
+    }
+    return closest.found;
+}
+
+std::string format_errors()
+{
+    std::string text;
+    const size_t kept = std::min(s_error_count, ErrorCapacity);
+    for (size_t i = 0; i < kept; ++i) {
+        format_error(s_errors[i], text);
+        text += '\n';
+    }
+    if (s_error_count > kept)
+        text += "and " + std::to_string(s_error_count - kept) + " more errors\n";
+    return text;
+}
+
+void invalid_value(const StringRef& str)
+{
+    value_error(ErrorCode::InvalidValue, str);
+}
+
+bool value_invalid()
+{
+    return s_value_invalid;
+}
+
+#if defined(AP_STATS)
+Stats stats()
+{
+    Stats stats = s_stats;
+    stats.tokens = s_tokens.size ? s_tokens.size - 1 : 0;
+    stats.unknownTokens = s_unused;
+    return stats;
+}
+#endif // defined(AP_STATS)
+
+bool check_flag(const StringRef& flags, int argc, const char* const* argv)
+{
+    Aliases aliases;
+    separate_flags(flags, aliases);
+    AP_PHASE(lookup);
+    for (size_t j = 0; j < aliases.count; ++j)
+        for (int i = 1; i < argc; ++i) {
+            AP_COUNT(tokensScanned, 1);
+            AP_COUNT(comparisons, 1);
+            if (!std::strncmp(argv[i], aliases.items[j].data, aliases.items[j].size) && !argv[i][aliases.items[j].size])
+                return true;
+        }
+    return false;
+}
+
+void add_command(const StringRef& name, CommandHandler handler, const StringRef& msg)
+{
+    const Command command = { s_command_names.size, name.size, handler };
+    s_command_names.append(name.data, name.size);
+    s_commands.push_back(command);
+    index_last_command();
+    s_commands_changed = true;
+    if (s_complete) {
+        if (!s_complete_values && !spec::is_prefix(s_complete_word[0]))
+            add_candidate(name.data, name.size, false);
+    } else if (s_help) {
+        AP_PHASE(help);
+        add_help_entry(name.str(), expand_patterns(msg, ""));
+    }
+}
+
+void add_choices(const StringRef& flags, const StringRef& choices)
+{
+    if (!s_complete && !s_help)
+        check_choices(flags, choices);
+    if (!s_complete || !s_complete_flag)
+        return;
+    AP_PHASE(help);
+    Aliases aliases;
+    separate_flags(flags, aliases);
+    complete_flag(aliases, &choices);
+}
+
+std::string completion_script(const StringRef& shell, const StringRef& program)
+{
+    const char* slash = program.data + program.size;
+    while (slash > program.data && slash[-1] != '/')
+        --slash;
+    const std::string name(slash, program.data + program.size);
+    std::string function = "_ap_complete_" + name;
+    for (size_t i = 0; i < function.size(); ++i)
+        if (!std::isalnum(static_cast<unsigned char>(function[i])))
+            function[i] = '_';
+
+    const std::string query = shell.str();
+    if (query == "bash")
+        return function + "()\n"
+            "{\n"
+            "    local IFS=$'\\n'\n"
+            "    COMPREPLY=($(\"${COMP_WORDS[0]}\" --ap-complete \"$COMP_CWORD\" -- \"${COMP_WORDS[@]}\" 2>/dev/null))\n"
+            "}\n"
+            "complete -o default -F " + function + " " + name + "\n";
+    if (query == "zsh")
+        return "#compdef " + name + "\n" + function + "()\n"
+            "{\n"
+            "    local -a candidates\n"
+            "    candidates=(\"${(@f)$(\"${words[1]}\" --ap-complete $((CURRENT - 1)) -- \"${words[@]}\" 2>/dev/null)}\")\n"
+            "    candidates=(${candidates:#})\n"
+            "    if (( $#candidates )); then\n"
+            "        compadd -- \"${candidates[@]}\"\n"
+            "    else\n"
+            "        _files\n"
+            "    fi\n"
+            "}\n"
+            "compdef " + function + " " + name + "\n";
+    if (query == "fish")
+        return "function " + function + "\n"
+            "    set -l words (commandline -opc)\n"
+            "    set -l current (commandline -ct)\n"
+            "    $words[1] --ap-complete (count $words) -- $words \"$current\" 2>/dev/null\n"
+            "end\n"
+            "complete -c " + name + " -a '(" + function + ")'\n";
+    return std::string();
+}
+
+bool add_option_group(const OptionGroup& group)
+{
+    bool used = s_help;
+    for (const OptionSpec* spec = group.specs; !used && spec->flagsSize; ++spec)
+        used = find_token(spec->flags(group.strings));
+    if (used)
+        group.parse(group.context);
+    return used;
+}
+
+bool find_command()
+{
+    return parse_end() < s_tokens.size && !(s_help && s_help_token < s_end);
+}
+
+int run_command()
+{
+    const CommandHandler handler = s_commands.data[s_command].handler;
+    char** const argv = const_cast<char**>(s_argv) + s_command_arg;
+    clear_help();
+    s_help = false;
+    s_complete_nested = s_complete;
+    s_complete_values = s_complete_delimited;
+    const int result = handler(s_argc - s_command_arg, argv);
+    s_complete_nested = false;
+    return result;
+}
+
+bool take_flag(const StringRef& flags, StringRef& value)
+{
+    if (!take_flag_value(find_flag(flags), value))
+        return false;
+    AP_COUNT(parsedFlags, 1);
+    return true;
+}
+
+bool take_bootstrap_flag(const StringRef& flags, StringRef& value)
+{
+    begin_spec(flags);
+    if (!take_flag_value(find_token(flags), value))
+        return false;
+    AP_COUNT(parsedFlags, 1);
+    return true;
+}
+
+size_t take_flags(const StringRef& flags, bool withValue)
+{
+    if (!s_tokens_indexed && s_tokens.size > s_index_min_tokens)
+        index_tokens();
+    AP_PHASE(lookup);
+    AP_COUNT(definedFlags, 1);
+    begin_spec(flags);
+    Aliases aliases;
+    separate_flags(flags, aliases);
+    const size_t end = parse_end();
+    s_taken.size = 0;
+    s_taken_tokens.size = 0;
+    s_taken_spec = s_definition_count;
+
+    // The chains of the aliases are merged in token order, the consumed tokens are skipped for good.
+    size_t* heads[Aliases::Capacity];
+    if (s_tokens_indexed)
+        for (size_t a = 0; a < aliases.count; ++a)
+            heads[a] = &alias_first(aliases.items[a].data, aliases.items[a].size);
+    size_t scan = s_next_arg;
+    while (true) {
+        size_t i = end;
+        if (s_tokens_indexed) {
+            for (size_t a = 0; a < aliases.count; ++a) {
+                size_t& head = *heads[a];
+                skip_used(head);
+                if (head && !is_used(head) && head < i)
+                    i = head;
+            }
+        } else {
+            while (scan < end && (is_used(scan) || !aliases.contains(s_tokens.data[scan])))
+                ++scan;
+            i = scan;
+        }
+        AP_COUNT(tokensScanned, 1);
+        if (i >= end)
+            break;
+
+        StringRef value;
+        if (withValue && !take_flag_value(i, value))
+            break;
+        if (!withValue)
+            use_token(i);
+        const Token taken = { value.data, value.size, s_parse, '\0' };
+        s_taken.push_back(taken);
+        s_taken_tokens.push_back(withValue ? s_value_token : i);
+    }
+    AP_COUNT(parsedFlags, s_taken.size);
+    return s_taken.size;
+}
+
+StringRef taken_value(size_t i)
+{
+    const StringRef value(s_taken.data[i].data, s_taken.data[i].size);
+    set_value(value, s_taken_tokens.data[i]);
+    return value;
+}
+
+bool take_arg(StringRef& value)
+{
+    AP_COUNT(definedArgs, 1);
+    begin_spec(StringRef());
+    if (s_next_arg >= parse_end())
+        return false;
+    AP_COUNT(parsedArgs, 1);
+    value = StringRef(s_tokens.data[s_next_arg].data, s_tokens.data[s_next_arg].size);
+    set_value(value, s_next_arg);
+    use_token(s_next_arg);
+    return true;
+}
+
+void add_flag_help(const StringRef& flags, const std::string& def, const StringRef& msg)
+{
+    AP_PHASE(help);
+    AP_COUNT(definedFlags, 1);
+    if (s_complete) {
+        Aliases aliases;
+        separate_flags(flags, aliases);
+        complete_flag(aliases, nullptr);
+        return;
+    }
+    add_help_entry(expand_patterns(flags, def), expand_patterns(msg, def));
+}
+
+/*! The template is scanned once from left to right and the substituted values are never
+ *  scanned again, so the cost is linear in the size of the result even if a value contains
+ *  a pattern itself.
+ */
+std::string expand_patterns(const StringRef& str, const StringRef& def)
+{
+    const StringRef program = s_tokens.size ? StringRef(s_tokens.data[0].data, s_tokens.data[0].size) : StringRef();
+    std::string result;
+    result.reserve(str.size);
+    const char* const end = str.data + str.size;
+    const char* begin = str.data;
+    for (const char* pos = begin; pos + 1 < end; ++pos) {
+        if (*pos != '%' || (pos[1] != 'p' && pos[1] != 'd'))
+            continue;
+        const StringRef& value = pos[1] == 'p' ? program : def;
+        result.append(begin, pos).append(value.data, value.size);
+        begin = ++pos + 1;
+    }
+    return result.append(begin, end);
+}
+
+/*! The description column comes from 's_alignment' or from the longest flag spec, and the
+ *  descriptions are word-wrapped to the page width. Every byte of the entries is visited once.
+ */
+void layout_help(std::string& page)
+{
+    const size_t indent = 2, gap = 2, minText = 20;
+    const size_t width = help_width();
+    size_t column = s_alignment > 0 ? s_alignment : indent + s_help_longest_spec + gap;
+    if (s_alignment <= 0 && column + minText > width)
+        column = width > 2 * minText ? width - minText : minText;
+    const size_t textWidth = width > column + minText ? width - column : minText;
+
+    page.reserve(page.size() + s_help_buffer.size + s_help_entries.size * (column + 1));
+    const char* buffer = s_help_buffer.data;
+    for (size_t i = 0; i < s_help_entries.size; ++i) {
+        const HelpEntry& entry = s_help_entries.data[i];
+        const char* text = buffer + entry.text;
+        const char* const textEnd = text + entry.textSize;
+        if (!entry.specSize) {
+            page.append(text, entry.textSize).push_back('\n');
+            continue;
+        }
+
+        page.append(indent, ' ').append(buffer + entry.spec, entry.specSize);
+        size_t pos = indent + entry.specSize;
+        if (pos + gap > column) {
+            page.push_back('\n');
+            pos = 0;
+        }
+        page.append(column - pos, ' ');
+
+        bool first = true;
+        do {
+            const char* lineEnd = text;
+            while (lineEnd < textEnd && *lineEnd != '\n')
+                ++lineEnd;
+            while (text < lineEnd && *text == ' ')
+                ++text;
+            if (!first)
+                page.append(column, ' ');
+            first = false;
+            size_t lineSize = 0;
+            while (text < lineEnd) {
+                const char* wordEnd = text;
+                while (wordEnd < lineEnd && *wordEnd != ' ')
+                    ++wordEnd;
+                const size_t wordSize = wordEnd - text;
+                if (lineSize && lineSize + 1 + wordSize > textWidth) {
+                    page.push_back('\n');
+                    page.append(column, ' ');
+                    lineSize = 0;
+                } else if (lineSize) {
+                    page.push_back(' ');
+                    ++lineSize;
+                }
+                page.append(text, wordSize);
+                lineSize += wordSize;
+                text = wordEnd;
+                while (text < lineEnd && *text == ' ')
+                    ++text;
+            }
+            page.push_back('\n');
+            text = lineEnd + 1;
+        } while (text < textEnd);
+    }
+
+    clear_help();
+}
+
+bool take_help_page(std::string& page)
+{
+    s_help_pending = false;
+    if (s_complete && s_complete_shell) {
+        page += completion_script(s_complete_shell, StringRef(s_tokens.data[0].data, s_tokens.data[0].size));
+        return true;
+    }
+    if (s_complete) {
+        AP_PHASE(help);
+        layout_completion(page);
+        return true;
+    }
+    if (!s_help_entries.size)
+        return false;
+    AP_PHASE(help);
+    layout_help(page);
+    return true;
+}
+
+void answer_completion()
+{
+    std::string page;
+    take_help_page(page);
+    std::fwrite(page.data(), 1, page.size(), stdout);
+    std::exit(std::fflush(stdout) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void flush_help(Writer& out)
+{
+    if (s_complete)
+        answer_completion();
+    std::string page;
+    if (take_help_page(page))
+        out.write(out.context, page.data(), page.size());
+}
+
+void read_value(const StringRef& str, bool& value)
+{
+    long result = 0;
+    read_signed(str, result);
+    value = result;
+}
+
+void read_value(const StringRef& str, char& value) { read_char(str, value); }
+void read_value(const StringRef& str, signed char& value) { read_char(str, value); }
+void read_value(const StringRef& str, unsigned char& value) { read_char(str, value); }
+void read_value(const StringRef& str, short& value) { read_signed(str, value); }
+void read_value(const StringRef& str, unsigned short& value) { read_unsigned(str, value); }
+void read_value(const StringRef& str, int& value) { read_signed(str, value); }
+void read_value(const StringRef& str, unsigned& value) { read_unsigned(str, value); }
+void read_value(const StringRef& str, long& value) { read_signed(str, value); }
+void read_value(const StringRef& str, unsigned long& value) { read_unsigned(str, value); }
+void read_value(const StringRef& str, long long& value) { read_signed(str, value); }
+void read_value(const StringRef& str, unsigned long long& value) { read_unsigned(str, value); }
+void read_value(const StringRef& str, float& value) { read_float(std::strtof, str, value); }
+void read_value(const StringRef& str, double& value) { read_float(std::strtod, str, value); }
+void read_value(const StringRef& str, long double& value) { read_float(std::strtold, str, value); }
+void read_value(const StringRef& str, std::string& value)
+{
+    AP_COUNT(conversions, 1);
+    value.assign(str.data, str.size);
+}
+
+void read_value(const StringRef& str, StringRef& value)
+{
+    value = str;
+}
+
+std::string format_value(bool value) { return value ? "1" : "0"; }
+std::string format_value(char value) { return std::string(1, value); }
+std::string format_value(signed char value) { return std::string(1, value); }
+std::string format_value(unsigned char value) { return std::string(1, value); }
+std::string format_value(short value) { return std::to_string(value); }
+std::string format_value(unsigned short value) { return std::to_string(value); }
+std::string format_value(int value) { return std::to_string(value); }
+std::string format_value(unsigned value) { return std::to_string(value); }
+std::string format_value(long value) { return std::to_string(value); }
+std::string format_value(unsigned long value) { return std::to_string(value); }
+std::string format_value(long long value) { return std::to_string(value); }
+std::string format_value(unsigned long long value) { return std::to_string(value); }
+std::string format_value(float value) { return format_float("%g", value); }
+std::string format_value(double value) { return format_float("%g", value); }
+std::string format_value(long double value) { return format_float("%Lg", value); }
+std::string format_value(const char* value) { return value; }
+std::string format_value(const std::string& value) { return value; }
+std::string format_value(const StringRef& value) { return value.str(); }
+
+} // namespace ap
@@ -27,62 +27,686 @@
 
 /*** Interface ***************************************************************/
 
-/*! \brief Initialize parser and define help flag */
-#define PARSE_HELP(FLAGS, MSG, USAGE, ARGC, ARGV) [&](){\
-    /* copy and setup argv */ for (int i = 0; i < ARGC; ++i) { std::string av = std::string(ARGV[i]); size_t pos = av.find_first_of(ap::s_long_flag_delimiter); if (std::string::npos != pos) { ap::s_argv.push_back(av.substr(0, pos)); av = av.substr(pos + 1); } ap::s_argv.push_back(av); } \
-    /* check help */ if (CHECK_FLAG(FLAGS, ARGC, ARGV)) { ap::s_help = true; AP_STDOUT << PTRNS(USAGE, "") << std::endl; PRINT_HELP(FLAGS, ap::s_help, MSG); } \
-    /* parse value */ return ap::s_help;\
-    }()
+/*! \brief Initialize parser and define help flag, a help page not flushed by FLUSH_HELP is printed at exit or by the next PARSE_HELP */
+#define PARSE_HELP(FLAGS, MSG, USAGE, ARGC, ARGV) ap::parse_help(FLAGS, MSG, USAGE, ARGC, ARGV, ap::help_output(AP_STDOUT))
+
+/*! \brief Like PARSE_HELP, for the argv of the last parse where REMOVED arguments from FIRST are replaced (see ap::parse_edit()) */
+#define PARSE_EDIT(FLAGS, MSG, USAGE, ARGC, ARGV, FIRST, REMOVED) ap::parse_edit(FLAGS, MSG, USAGE, ARGC, ARGV, FIRST, REMOVED, ap::help_output(AP_STDOUT))
 
 /*! \brief Define flag */
-#define PARSE_FLAG(FLAGS, DEFAULT, MSG) [&](){\
-    /* show help */ if (ap::s_help) { PRINT_HELP(FLAGS, DEFAULT, MSG); return DEFAULT; }\
-    /* parse value */ return [&](){\
-        /* check flag */ size_t j = [&]()->size_t { std::vector<std::string> flags; SEPARATE_FLAGS(FLAGS, flags); for (size_t i = 1; i < ap::s_argv.size(); ++i) for (size_t fi = 0; fi < flags.size(); ++fi) if (ap::s_argv[i] == flags[fi]) return i; return 0; }();\
-        /* parse value */ auto value = DEFAULT; if (j) { if (typeid(DEFAULT) == typeid(bool)) { ap::s_argv.insert(ap::s_argv.begin() + j + 1, (*reinterpret_cast<bool*>(&value) ? "0" : "1")); } if ((++j) < ap::s_argv.size()) { std::string av = std::string(ap::s_argv[j]); std::istringstream iss(av); if (typeid(DEFAULT) == typeid(std::string)) value = *(reinterpret_cast<decltype(DEFAULT)*>(&av)); else iss >> value; ap::s_argv.erase(ap::s_argv.begin() + j); ap::s_argv.erase(ap::s_argv.begin() + j - 1); } }\
-        /* return value */ return value;\
-        }();\
-    }()
+#define PARSE_FLAG(FLAGS, DEFAULT, MSG) ap::parse_flag(FLAGS, DEFAULT, MSG)
+
+/*! \brief Define repeatable flag, the values of all occurrences replace the content of the DEFAULT container */
+#define PARSE_FLAG_ALL(FLAGS, DEFAULT, MSG) ap::parse_flag_all(FLAGS, DEFAULT, MSG)
+
+/*! \brief Define repeatable flag, the value of the last occurrence wins */
+#define PARSE_FLAG_LAST(FLAGS, DEFAULT, MSG) ap::parse_flag_last(FLAGS, DEFAULT, MSG)
+
+/*! \brief Define flag read in place into *DEST, whose current value is the default, return true if the flag is given */
+#define BIND_FLAG(FLAGS, DEST, MSG) ap::bind_flag(FLAGS, DEST, MSG)
+
+/*! \brief Like PARSE_FLAG_ALL, the values replace the content of the *DEST container, return the number of occurrences */
+#define BIND_FLAG_ALL(FLAGS, DEST, MSG) ap::bind_flag_all(FLAGS, DEST, MSG)
+
+/*! \brief Define repeatable flag without value, return the number of its occurrences */
+#define COUNT_FLAG(FLAGS, MSG) ap::count_flag(FLAGS, MSG)
 
 /*! \brief Define argument */
-#define PARSE_ARG(DEFAULT) [&](){\
-    /* parse next argument */ auto arg = DEFAULT; if (ap::s_argv.size() > 1) { std::stringstream ss(ap::s_argv[1]); ss >> arg; ap::s_argv.erase(ap::s_argv.begin() + 1); } return arg;\
-    }()
+#define PARSE_ARG(DEFAULT) (FLUSH_HELP(), ap::parse_arg(DEFAULT))
+
+/*! \brief Define argument read in place into *DEST, whose current value is the default, return true if it is given */
+#define BIND_ARG(DEST) (FLUSH_HELP(), ap::bind_arg(DEST))
 
 /*! \brief Add message */
-#define ADD_MSG(MSG) [&](){ if (ap::s_help) AP_STDOUT << PTRNS(MSG, "") << std::endl; }()
+#define ADD_MSG(MSG) ap::add_msg(MSG)
+
+/*! \brief Print the collected help page (PARSE_ARG and UNPARSED_COUNT call it too) */
+#define FLUSH_HELP() ap::flush_help(AP_STDOUT)
 
 /*! \brief Return number of unparsed arguments */
-#define UNPARSED_COUNT() (ap::s_argv.size() - 1)
+#define UNPARSED_COUNT() (FLUSH_HELP(), ap::unparsed_count())
+
+/*! \brief Report the unparsed arguments as errors, return the number of errors of the parse (see ap::Error) */
+#define FINISH_PARSE() (FLUSH_HELP(), ap::finish_parse())
+
+/*! \brief Return the number of errors of the parse */
+#define ERROR_COUNT() ap::error_count()
+
+/*! \brief Return the errors of the parse as text, one per line */
+#define FORMAT_ERRORS() ap::format_errors()
 
 /*! \brief Check flags */
-#define CHECK_FLAG(FLAGS, ARGC, ARGV) [&]()->bool { std::vector<std::string> flags; SEPARATE_FLAGS(FLAGS, flags); for (size_t j = 0; j < flags.size(); ++j) for (int i = 1; i < ARGC; ++i) if (flags[j] == std::string(ARGV[i])) return true; return false; }()
+#define CHECK_FLAG(FLAGS, ARGC, ARGV) ap::check_flag(FLAGS, ARGC, ARGV)
+
+/*! \brief Check whether a flag is given and not parsed yet, without scanning argv again */
+#define HAS_FLAG(FLAGS) ap::has_flag(FLAGS)
+
+/*! \brief Define flag which is parsed even if the help is requested, for options deciding the other ones */
+#define PARSE_BOOTSTRAP_FLAG(FLAGS, DEFAULT, MSG) ap::parse_bootstrap_flag(FLAGS, DEFAULT, MSG)
+
+/*! \brief Define a subcommand, its handler is called only by RUN_COMMAND (define them before the flags) */
+#define ADD_COMMAND(NAME, HANDLER, MSG) ap::add_command(NAME, HANDLER, MSG)
+
+/*! \brief Return the result of the handler of the subcommand in argv, or flush the help and return DEFAULT */
+#define RUN_COMMAND(DEFAULT) (ap::find_command() ? ap::run_command() : (FLUSH_HELP(), (DEFAULT)))
+
+/*! \brief Add the values of a flag offered by the shell completion, as a comma separated list, the value of the flag is checked against them */
+#define ADD_CHOICES(FLAGS, CHOICES) ap::add_choices(FLAGS, CHOICES)
+
+#if defined(AP_STATS)
+/*! \brief Return the ap::Stats of the parse since PARSE_HELP, only if built with AP_STATS */
+#define PARSE_STATS() ap::stats()
+#endif // defined(AP_STATS)
+
+/*! \brief Declare a struct of options from an X-macro list
+ *
+ *  'LIST' is a macro taking a macro and calling it with every option as
+ *  OPTION(ID, TYPE, DEFAULT, FLAGS, MSG), like:
+ *
+ *      #define MY_OPTIONS(OPTION) \
+ *          OPTION(size, int, 300, "-s, --size SIZE", "set size. Default is '%d'.") \
+ *          OPTION(enable, bool, false, "-e, --enable", "enable something.")
+ *      AP_OPTIONS(MyOptions, MY_OPTIONS);
+ *
+ *  The struct has a member per option initialized with its DEFAULT. The specs and helps are
+ *  stored in constant tables, and malformed specs or duplicated aliases are compile errors.
+ *  stamp_changes() sets 'version' in 'versions' for every option which differs from
+ *  'previous', for the reloaded snapshots of ap::Config.
+ */
+#define AP_OPTIONS(NAME, LIST) struct NAME {\
+    /* members */ LIST(AP_OPTION_MEMBER)\
+    /* indices */ enum { LIST(AP_OPTION_INDEX) OptionCount };\
+    /* checks */ static constexpr const char* s_specFlags[] = { LIST(AP_OPTION_FLAGS) nullptr }; LIST(AP_OPTION_CHECK)\
+    /* tables */ struct Strings { LIST(AP_OPTION_STRING_LAYOUT) char end; };\
+    static const char* strings() { static constexpr char table[] = LIST(AP_OPTION_STRINGS) ""; return table; }\
+    static const ap::OptionSpec* specs() { static constexpr ap::OptionSpec table[] = { LIST(AP_OPTION_SPEC) { 0, 0, 0, 0 } }; return table; }\
+    /* parse */ void parse() { LIST(AP_OPTION_PARSE) }\
+    /* changes */ void stamp_changes(const NAME& previous, unsigned long* versions, unsigned long version) const { LIST(AP_OPTION_STAMP) }\
+    }
+
+/*! \brief Parse the options of a struct declared with AP_OPTIONS, after PARSE_HELP */
+#define PARSE_OPTIONS(OPTIONS) (OPTIONS).parse()
+
+/*! \brief Like PARSE_OPTIONS, but only if argv has one of the options or the help is requested */
+#define PARSE_OPTION_GROUP(OPTIONS) ap::parse_option_group(OPTIONS)
 
 #if !defined(AP_STDOUT)
-#define AP_STDOUT std::cout
+#define AP_STDOUT ap::s_stdout
 #endif // !defined(AP_STDOUT)
 
 /*** Helpers *****************************************************************/
 
-#include <iostream>
-#include <sstream>
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
 #include <string>
-#include <typeinfo>
-#include <vector>
+#include <type_traits>
+#include <utility>
+
+#define AP_OPTION_MEMBER(ID, TYPE, DEFAULT, FLAGS, MSG) TYPE ID = DEFAULT;
+#define AP_OPTION_INDEX(ID, TYPE, DEFAULT, FLAGS, MSG) ID##_index,
+#define AP_OPTION_FLAGS(ID, TYPE, DEFAULT, FLAGS, MSG) FLAGS,
+#define AP_OPTION_CHECK(ID, TYPE, DEFAULT, FLAGS, MSG)\
+    static_assert(ap::spec::is_valid(FLAGS, std::is_same<TYPE, bool>::value), "Malformed option spec: " FLAGS);\
+    AP_OPTION_CHECK_UNIQUE(ID, FLAGS)
+/* The duplicate check compares every pair of aliases, define AP_NO_UNIQUE_CHECK to skip it in big tables. */
+#if defined(AP_NO_UNIQUE_CHECK)
+#define AP_OPTION_CHECK_UNIQUE(ID, FLAGS)
+#else
+#define AP_OPTION_CHECK_UNIQUE(ID, FLAGS)\
+    static_assert(ap::spec::is_unique(s_specFlags, ID##_index, OptionCount), "Duplicated alias in option spec: " FLAGS);
+#endif // defined(AP_NO_UNIQUE_CHECK)
+#define AP_OPTION_STRING_LAYOUT(ID, TYPE, DEFAULT, FLAGS, MSG) char ID##_flags[sizeof(FLAGS)]; char ID##_msg[sizeof(MSG)];
+#define AP_OPTION_STRINGS(ID, TYPE, DEFAULT, FLAGS, MSG) FLAGS "\0" MSG "\0"
+#define AP_OPTION_SPEC(ID, TYPE, DEFAULT, FLAGS, MSG) { offsetof(Strings, ID##_flags), sizeof(FLAGS) - 1, offsetof(Strings, ID##_msg), sizeof(MSG) - 1 },
+#define AP_OPTION_PARSE(ID, TYPE, DEFAULT, FLAGS, MSG) ap::bind_flag(specs()[ID##_index].flags(strings()), &ID, specs()[ID##_index].msg(strings()));
+#define AP_OPTION_STAMP(ID, TYPE, DEFAULT, FLAGS, MSG) if (!ap::same_value(ID, previous.ID, 0)) versions[ID##_index] = version;
 
 namespace ap {
 
-std::vector<std::string> s_argv;
-bool s_help = false;
-int s_alignment = 25;
-std::string s_short_flag_prefixes = "";
-std::string s_long_flag_delimiter = "=";
-
-#define SEPARATE_FLAGS(FLAGS, ARRAY) [&](){ std::stringstream ss(FLAGS); std::string flag; while (std::getline(ss, flag, ',')) { TRIM_SPACES(flag); ARRAY.push_back(flag);} std::string& lastFlag = ARRAY.back(); size_t pos = lastFlag.find_last_of(" \t"); if (std::string::npos != pos) TRIM_SPACES(lastFlag.erase(pos)); }()
-#define PRINT_HELP(FLAGS, DEFAULT, MSG) [&](){ std::stringstream defStream; defStream << DEFAULT; std::string flags = PTRNS(FLAGS, defStream.str()); int size = ap::s_alignment - std::string(flags).size() - 2; AP_STDOUT << "  " << flags; std::stringstream msgStream(PTRNS(MSG, defStream.str())); std::string msg; bool first = true; while (std::getline(msgStream, msg, '\n')) { AP_STDOUT << std::string(first ? (size > 1 ? size : 2) : ap::s_alignment, ' ') << msg.erase(0, std::min(msg.find_first_not_of(' '), msg.size())) << std::endl; first = false; } }()
-#define REPLACE_PATTERN(MSG, PTRN, VALUE) [&](){ std::string str(MSG); std::string ptrn(PTRN); while (str.find(ptrn) < str.size()) str.replace(str.find(ptrn), ptrn.length(), std::string(VALUE)); return str; }()
-#define PTRNS(STR, DEF) REPLACE_PATTERN(REPLACE_PATTERN(STR, "%p", ap::s_argv[0]), "%d", DEF)
-#define TRIM_SPACES(STR) [&](){ size_t startpos = STR.find_first_not_of(" \t"); if (std::string::npos != startpos) STR.erase(0, startpos); size_t endpos = STR.find_last_not_of(" \t") + 1; if (std::string::npos != endpos) STR.erase(endpos); }()
+/*! \brief Output of the help page, AP_STDOUT can be a Writer or a std::ostream */
+struct Writer {
+    void (*write)(void* context, const char* data, size_t size);
+    void* context;
+};
+
+/* The state is constant initialized, nothing of the parser runs before main. Every thread
+ * has its own parse (s_help, s_complete and the tokens), the settings after them are shared.
+ */
+
+extern thread_local bool s_help;
+extern thread_local bool s_complete; /*< The help mode answers a shell completion query, see parse_help(). */
+extern int s_alignment; /*< Column of the descriptions, 0 means computed from the longest flag spec. */
+extern int s_width; /*< Width of the help page, 0 means the terminal width. */
+extern const char* s_short_flag_prefixes;
+extern const char* s_long_flag_delimiter;
+extern Writer s_stdout; /*< Writes to stdout with fwrite(). */
+
+/*! \brief Reference to the characters of a string literal or a std::string, without copying them */
+struct StringRef {
+    StringRef() : data(""), size(0) {}
+    StringRef(const char* str) : data(str), size(std::strlen(str)) {}
+    StringRef(const char* str, size_t length) : data(str), size(length) {}
+    StringRef(const std::string& str) : data(str.data()), size(str.size()) {}
+
+    std::string str() const { return std::string(data, size); }
+
+    const char* data;
+    size_t size;
+};
+
+/*! \brief Handler of a subcommand, called like main with argv from the name of the subcommand */
+typedef int (*CommandHandler)(int argc, char* argv[]);
+
+/*! \brief Counters of a parse, updated while parsing if the library is built with AP_STATS
+ *
+ *  A flag or an argument is counted as defined by every PARSE_FLAG or PARSE_ARG. The
+ *  conversions are the values read by the built-in read_value() overloads.
+ */
+struct Stats {
+    size_t tokens; /*< Tokens after the program name, a value joined with '=' is a token too. */
+    size_t tokensScanned; /*< Tokens visited while looking for flags and their values. */
+    size_t comparisons; /*< Comparisons of a token with an alias. */
+    size_t conversions;
+    size_t definedFlags, parsedFlags;
+    size_t definedArgs, parsedArgs;
+    size_t unknownTokens; /*< Tokens not used by any flag or argument yet. */
+    double tokenizeSeconds, lookupSeconds, conversionSeconds, helpSeconds;
+};
+
+/*! \brief Kind of an error of the parse */
+enum class ErrorCode {
+    ArgvIsEmpty, /*< argc is not positive, or argv or argv[0] is nullptr. */
+    ArgcExceedsArgv, /*< argv has a nullptr before argc, the arguments from it are ignored. */
+    MissingValue, /*< A flag with value is the last argument, or not the last one of its bundle. */
+    InvalidValue, /*< A value is not of the type of its flag or argument, the default is kept. */
+    ValueOutOfRange, /*< A number does not fit in its type, it is clamped. */
+    InvalidChoice, /*< A value is not one of the ADD_CHOICES of its flag, it is kept. */
+    UnknownFlag, /*< An unparsed argument with a flag prefix, see finish_parse(). */
+    UnexpectedArgument /*< An unparsed argument without a flag prefix, see finish_parse(). */
+};
+
+/*! \brief An error of the parse, recorded without allocating and formatted only by format_error()
+ *
+ *  The errors are kept until the next PARSE_HELP, in a buffer of ErrorCapacity errors, the
+ *  ones after it are only counted.
+ */
+struct Error {
+    ErrorCode code;
+    size_t token; /*< The token in argv order, 0 if the error is not of a token. */
+    size_t spec; /*< The flag or argument from 1 in the order of definition, 0 if the error is not of a definition. */
+    StringRef flags; /*< A copy of the spec of the flag (given to PARSE_FLAG) made by the parser, valid until the next definition, empty for an argument. */
+};
+
+const size_t ErrorCapacity = 16;
+
+/*! \brief Flag spec and help of an AP_OPTIONS member, as offsets in the string table of the struct */
+struct OptionSpec {
+    size_t flagsOffset, flagsSize;
+    size_t msgOffset, msgSize;
+
+    StringRef flags(const char* strings) const { return StringRef(strings + flagsOffset, flagsSize); }
+    StringRef msg(const char* strings) const { return StringRef(strings + msgOffset, msgSize); }
+};
+
+/*! \brief Options registered at runtime, e.g. by a plugin, see add_option_group() */
+struct OptionGroup {
+    const OptionSpec* specs; /*< Ends with a zero spec, like the table of AP_OPTIONS. */
+    const char* strings;
+    void (*parse)(void* context); /*< Defines the options with PARSE_FLAG. */
+    void* context;
+};
+
+/* Compile time checks of the AP_OPTIONS specs, written as C++11 constexpr recursions. */
+namespace spec {
+
+constexpr bool is_space(char c) { return c == ' ' || c == '\t'; }
+constexpr bool is_prefix(char c) { return c == '-' || c == '+'; }
+constexpr size_t skip_spaces(const char* s, size_t i) { return is_space(s[i]) ? skip_spaces(s, i + 1) : i; }
+constexpr size_t string_end(const char* s, size_t i) { return s[i] ? string_end(s, i + 1) : i; }
+constexpr size_t alias_end(const char* s, size_t i) { return (!s[i] || s[i] == ',' || is_space(s[i])) ? i : alias_end(s, i + 1); }
+
+/*! \brief Start of the alias after the one ending at 'j', or the end of 's' if that was the last one */
+constexpr size_t next_alias_at(const char* s, size_t j) { return s[j] == ',' ? skip_spaces(s, j + 1) : string_end(s, j); }
+constexpr size_t next_alias(const char* s, size_t i) { return next_alias_at(s, skip_spaces(s, alias_end(s, i))); }
+
+constexpr bool only_prefix(const char* s, size_t b, size_t e) { return b == e || (is_prefix(s[b]) && only_prefix(s, b + 1, e)); }
+constexpr bool is_valid_alias(const char* s, size_t b, size_t e) { return is_prefix(s[b]) && !only_prefix(s, b, e); }
+constexpr bool is_valid_aliases(const char* s, size_t i, bool flagOnly);
+constexpr bool is_valid_rest(const char* s, size_t j, bool flagOnly)
+{
+    return !s[j] || (s[j] == ',' ? is_valid_aliases(s, skip_spaces(s, j + 1), flagOnly) : (!flagOnly && !s[skip_spaces(s, alias_end(s, j))]));
+}
+constexpr bool is_valid_aliases(const char* s, size_t i, bool flagOnly)
+{
+    return is_valid_alias(s, i, alias_end(s, i)) && is_valid_rest(s, skip_spaces(s, alias_end(s, i)), flagOnly);
+}
+
+/*! \brief Return true if 's' is a comma separated list of aliases, with a value name after the last one unless 'flagOnly' */
+constexpr bool is_valid(const char* s, bool flagOnly) { return is_valid_aliases(s, skip_spaces(s, 0), flagOnly); }
+
+/*! \brief Return true if the alias 'a' of size 'n' is one of the aliases of 's' from 'i'
+ *
+ *  'k' is the number of matching characters of the current alias, or 'n + 1' after a mismatch.
+ *  Every character of 's' is visited once.
+ */
+constexpr bool has_alias(const char* s, size_t i, const char* a, size_t n, size_t k = 0)
+{
+    return (!s[i] || s[i] == ',' || is_space(s[i]))
+        ? (k == n || (s[skip_spaces(s, i)] == ',' && has_alias(s, skip_spaces(s, skip_spaces(s, i) + 1), a, n, 0)))
+        : has_alias(s, i + 1, a, n, (k < n && s[i] == a[k]) ? k + 1 : n + 1);
+}
+constexpr bool in_specs(const char* const* specs, size_t lo, size_t hi, const char* a, size_t n)
+{
+    return lo < hi && (hi - lo == 1 ? has_alias(specs[lo], skip_spaces(specs[lo], 0), a, n)
+        : (in_specs(specs, lo, lo + (hi - lo) / 2, a, n) || in_specs(specs, lo + (hi - lo) / 2, hi, a, n)));
+}
+constexpr bool has_duplicate(const char* const* specs, size_t p, size_t i, size_t count)
+{
+    return specs[p][i] && (has_alias(specs[p], next_alias(specs[p], i), specs[p] + i, alias_end(specs[p], i) - i)
+        || in_specs(specs, p + 1, count, specs[p] + i, alias_end(specs[p], i) - i)
+        || has_duplicate(specs, p, next_alias(specs[p], i), count));
+}
+
+/*! \brief Return true if no alias of 'specs[p]' appears again in it or in the specs after it */
+constexpr bool is_unique(const char* const* specs, size_t p, size_t count) { return !has_duplicate(specs, p, skip_spaces(specs[p], 0), count); }
+
+} // namespace spec
+
+/* Engine of the macros, every call site only passes its arguments to these. */
+
+/*! \brief Start a parse, return true if the help is requested
+ *
+ *  Argv of '--ap-complete CWORD -- WORDS...' is a shell completion query, like COMP_CWORD and
+ *  COMP_WORDS of bash. It is answered in help mode: the flags and subcommands starting with
+ *  the completed word are collected without converting or formatting anything, and the next
+ *  FLUSH_HELP() prints them to stdout and exits. Argv of '--ap-completion SHELL' prints the
+ *  script of completion_script() the same way.
+ *
+ *  The help page is collected until FLUSH_HELP(). A page which is not flushed is written to
+ *  'out' by the next parse_help() or parse_edit() of the thread, or when the process exits,
+ *  so a program defining only flags prints its help too.
+ */
+bool parse_help(const StringRef& flags, const StringRef& msg, const StringRef& usage, int argc, const char* const* argv, const Writer& out = s_stdout);
+
+/*! \brief Start a parse of an edited argv, like an interactive command line after a keystroke
+ *
+ *  'argv' is the argv of the last parse, where the 'removed' arguments from 'first' are
+ *  replaced with 'argc' minus the former count plus 'removed' new ones. The other arguments
+ *  have to be the same strings, the replaced ones can be freed. Only the new arguments are
+ *  split and indexed, and the tokens are not visited to reset them, so an edit which keeps
+ *  the number of tokens costs the same whatever the length of argv. An edit which changes
+ *  the number of tokens (a word split or joined, inserted or deleted) moves the tokens after
+ *  it and renumbers their index, so it is linear in the length of argv, though still much
+ *  cheaper than a full parse. The first call after a PARSE_HELP parses the whole argv.
+ */
+bool parse_edit(const StringRef& flags, const StringRef& msg, const StringRef& usage, int argc, const char* const* argv, size_t first, size_t removed, const Writer& out = s_stdout);
+bool parse_flag(const StringRef& flags, bool value, const StringRef& msg);
+bool bind_flag(const StringRef& flags, bool* value, const StringRef& msg);
+bool parse_bootstrap_flag(const StringRef& flags, bool value, const StringRef& msg);
+size_t count_flag(const StringRef& flags, const StringRef& msg);
+bool has_flag(const StringRef& flags);
+void add_msg(const StringRef& msg);
+size_t unparsed_count();
+#if defined(AP_STATS)
+Stats stats();
+#endif // defined(AP_STATS)
+bool check_flag(const StringRef& flags, int argc, const char* const* argv);
+
+/*! \brief Record an UnknownFlag or UnexpectedArgument error for every unparsed argument, except in help mode, return error_count() */
+size_t finish_parse();
+
+/*! \brief Return the number of errors of the parse, it can be more than ErrorCapacity */
+size_t error_count();
+
+/*! \brief Return the error 'i' of the parse, 'i' is less than ErrorCapacity and error_count() */
+const Error& error_at(size_t i);
+
+/*! \brief Append the text of 'error' to 'text', like "invalid value 'x' of '-s, --size SIZE'", with its suggestion */
+void format_error(const Error& error, std::string& text);
+
+/*! \brief Return the kept errors of the parse as text, one per line, and the number of the others */
+std::string format_errors();
+
+/*! \brief Return the alias, choice or subcommand closest to the token of 'error', or an empty one
+ *
+ *  An unknown flag is compared with the aliases, an unexpected argument with the subcommands
+ *  and the choices, and an invalid choice with the choices of its flag. The candidates are
+ *  collected by the first call, the parse does not spend anything on them.
+ */
+StringRef suggest(const Error& error);
+
+/*! \brief Record an InvalidValue error if 'str' is a value taken by the parse, see read_value() */
+void invalid_value(const StringRef& str);
+
+/*! \brief Return true if the value taken last is not of its type, its conversion kept the former value */
+bool value_invalid();
+
+/*! \brief Register a subcommand, or add its help line if the help is requested
+ *
+ *  The first argument naming a subcommand ends the arguments of the program, the flags and
+ *  arguments after it are left for the handler.
+ */
+void add_command(const StringRef& name, CommandHandler handler, const StringRef& msg);
+
+/*! \brief Offer 'choices' as the values of 'flags' if a completion query is answered, otherwise check the value
+ *
+ *  After the PARSE_FLAG of 'flags', a value which is not one of the choices is an InvalidChoice
+ *  error, the choices are the suggestions of it.
+ */
+void add_choices(const StringRef& flags, const StringRef& choices);
+
+/*! \brief Return the script of 'shell' (bash, zsh or fish) completing 'program', or an empty string */
+std::string completion_script(const StringRef& shell, const StringRef& program);
+
+/*! \brief Call the parse of 'group' if argv has one of its flags or the help is requested
+ *
+ *  Return true if the group was parsed. The flags are looked up in the token index, so a group
+ *  not referenced by argv costs a hash lookup per alias, and none of its values are converted
+ *  or formatted.
+ */
+bool add_option_group(const OptionGroup& group);
+
+/*! \brief Return true if argv names a subcommand, and the help is not requested before it */
+bool find_command();
+
+/*! \brief Call the handler of the subcommand found by find_command(), it starts a new parse */
+int run_command();
+
+/*! \brief Consume the first of 'flags' and the argument after it, and point 'value' to that argument
+ *
+ *  Return false and leave the arguments as they are if none of the flags is present, or if
+ *  no argument follows it.
+ */
+bool take_flag(const StringRef& flags, StringRef& value);
+
+/*! \brief Like take_flag(), for a flag which is also on the help page or counted already */
+bool take_bootstrap_flag(const StringRef& flags, StringRef& value);
+
+/*! \brief Consume every occurrence of 'flags', with the argument after it if 'withValue', and return their number
+ *
+ *  The occurrences are found in one pass over the token index. Their arguments can be read
+ *  with taken_value() until the next call.
+ */
+size_t take_flags(const StringRef& flags, bool withValue);
+StringRef taken_value(size_t i);
+
+/*! \brief Consume the next unparsed argument and point 'value' to it, return false if there is none */
+bool take_arg(StringRef& value);
+
+/*! \brief Collect the help line of a flag, where '%d' is substituted with 'def' */
+void add_flag_help(const StringRef& flags, const std::string& def, const StringRef& msg);
+
+/*! \brief Substitute '%p' with the program name and '%d' with 'def' in 'str' */
+std::string expand_patterns(const StringRef& str, const StringRef& def);
+
+/*! \brief Lay out the collected help entries into 'page' and clear them */
+void layout_help(std::string& page);
+
+/*! \brief Lay out the collected help page (or the answer of a completion query) into 'page', return false if nothing was collected */
+bool take_help_page(std::string& page);
+
+/*! \brief Write the answer of a completion query to stdout and exit */
+[[noreturn]] void answer_completion();
+
+/*! \brief Write the collected help page to 'out' if there is any */
+void flush_help(Writer& out);
+
+template <typename Stream>
+void write_stream(void* context, const char* data, size_t size)
+{
+    Stream& out = *static_cast<Stream*>(context);
+    out.write(data, size);
+    out.flush();
+}
+
+/*! \brief Return AP_STDOUT as a Writer, for the help page which is not flushed */
+inline Writer help_output(Writer& out)
+{
+    return out;
+}
+
+inline Writer help_output(const Writer& out)
+{
+    return out;
+}
+
+template <typename Stream>
+Writer help_output(Stream& out)
+{
+    const Writer writer = { write_stream<Stream>, &out };
+    return writer;
+}
+
+template <typename Stream>
+void flush_help(Stream& out)
+{
+    if (s_complete)
+        answer_completion();
+    std::string page;
+    if (take_help_page(page)) {
+        out << page;
+        out.flush();
+    }
+}
+
+/*! \brief Convert an argument to a value
+ *
+ *  The built-in types are converted out-of-line. Other types are read with operator>>, for
+ *  those include <sstream> before using them with PARSE_FLAG or PARSE_ARG. A value which is
+ *  not of the type is an InvalidValue error and the value is kept, a number which does not
+ *  fit is clamped and it is a ValueOutOfRange error.
+ */
+void read_value(const StringRef& str, bool& value);
+void read_value(const StringRef& str, char& value);
+void read_value(const StringRef& str, signed char& value);
+void read_value(const StringRef& str, unsigned char& value);
+void read_value(const StringRef& str, short& value);
+void read_value(const StringRef& str, unsigned short& value);
+void read_value(const StringRef& str, int& value);
+void read_value(const StringRef& str, unsigned& value);
+void read_value(const StringRef& str, long& value);
+void read_value(const StringRef& str, unsigned long& value);
+void read_value(const StringRef& str, long long& value);
+void read_value(const StringRef& str, unsigned long long& value);
+void read_value(const StringRef& str, float& value);
+void read_value(const StringRef& str, double& value);
+void read_value(const StringRef& str, long double& value);
+void read_value(const StringRef& str, std::string& value);
+void read_value(const StringRef& str, StringRef& value); /*< A view of the argument in argv. */
+
+/*! \brief Convert a default value to the text of '%d' (see read_value() about other types) */
+std::string format_value(bool value);
+std::string format_value(char value);
+std::string format_value(signed char value);
+std::string format_value(unsigned char value);
+std::string format_value(short value);
+std::string format_value(unsigned short value);
+std::string format_value(int value);
+std::string format_value(unsigned value);
+std::string format_value(long value);
+std::string format_value(unsigned long value);
+std::string format_value(long long value);
+std::string format_value(unsigned long long value);
+std::string format_value(float value);
+std::string format_value(double value);
+std::string format_value(long double value);
+std::string format_value(const char* value);
+std::string format_value(const std::string& value);
+std::string format_value(const StringRef& value);
+
+template <typename T>
+struct StringStreams {
+    typedef std::istringstream In;
+    typedef std::ostringstream Out;
+};
+
+template <typename T>
+void read_value(const StringRef& str, T& value)
+{
+    typename StringStreams<T>::In in(str.str());
+    if (!(in >> value))
+        invalid_value(str);
+}
+
+template <typename T>
+std::string format_value(const T& value)
+{
+    typename StringStreams<T>::Out out;
+    out << value;
+    return out.str();
+}
+
+/*! \brief Join the formatted values of a container with commas */
+template <typename Container>
+std::string format_values(const Container& values)
+{
+    std::string text;
+    for (typename Container::const_iterator it = values.begin(); it != values.end(); ++it)
+        text.append(it == values.begin() ? "" : ", ").append(format_value(static_cast<const typename Container::value_type&>(*it)));
+    return text;
+}
+
+/*! \brief Return true if two values are equal, compared as their formatted texts if T has no operator== */
+template <typename T>
+auto same_value(const T& a, const T& b, int) -> decltype(bool(a == b))
+{
+    return a == b;
+}
+
+template <typename T>
+bool same_value(const T& a, const T& b, long)
+{
+    return format_value(a) == format_value(b);
+}
+
+/*! \brief Read the value of the flag into *value, nothing is copied when it is not given
+ *
+ *  The value is converted into the destination, so a string or a container reuses its
+ *  storage, and an invalid value keeps the former one (see ap::ErrorCode::InvalidValue).
+ */
+template <typename T>
+bool bind_flag(const StringRef& flags, T* value, const StringRef& msg)
+{
+    StringRef arg;
+    if (s_help) {
+        add_flag_help(flags, s_complete ? std::string() : format_value(*value), msg);
+        return false;
+    }
+    if (!take_flag(flags, arg))
+        return false;
+    read_value(arg, *value);
+    return true;
+}
+
+template <typename T>
+T parse_flag(const StringRef& flags, T value, const StringRef& msg)
+{
+    bind_flag(flags, &value, msg);
+    return value;
+}
+
+template <typename T>
+T parse_bootstrap_flag(const StringRef& flags, T value, const StringRef& msg)
+{
+    StringRef arg;
+    if (s_help)
+        add_flag_help(flags, s_complete ? std::string() : format_value(value), msg);
+    if (take_bootstrap_flag(flags, arg))
+        read_value(arg, value);
+    return value;
+}
+
+/*! \brief Reserve 'count' values if the container has reserve() */
+template <typename Container>
+auto reserve_values(Container& values, size_t count, int) -> decltype(values.reserve(count), void())
+{
+    values.reserve(count);
+}
+
+template <typename Container>
+void reserve_values(Container&, size_t, long)
+{
+}
+
+/*! \brief Read the values of every occurrence of the flag into *values, in argv order
+ *
+ *  The container has to have value_type, clear() and push_back(), like std::vector (also of
+ *  bool), std::deque, std::list or std::basic_string. It is reserved if it has reserve().
+ *  The values which are not of their type are skipped, their errors are recorded, and the
+ *  content is replaced only if a valid value is given.
+ */
+template <typename Container>
+size_t bind_flag_all(const StringRef& flags, Container* values, const StringRef& msg)
+{
+    typedef typename Container::value_type Value;
+    if (s_help) {
+        add_flag_help(flags, s_complete ? std::string() : format_values(*values), msg);
+        return 0;
+    }
+    const size_t count = take_flags(flags, true);
+    bool replaced = false;
+    for (size_t i = 0; i < count; ++i) {
+        Value value = Value();
+        read_value(taken_value(i), value);
+        if (value_invalid())
+            continue;
+        if (!replaced) {
+            values->clear();
+            reserve_values(*values, count, 0);
+            replaced = true;
+        }
+        values->push_back(std::move(value));
+    }
+    return count;
+}
+
+template <typename Container>
+Container parse_flag_all(const StringRef& flags, Container values, const StringRef& msg)
+{
+    bind_flag_all(flags, &values, msg);
+    return values;
+}
+
+template <typename T>
+T parse_flag_last(const StringRef& flags, T value, const StringRef& msg)
+{
+    if (s_help)
+        add_flag_help(flags, s_complete ? std::string() : format_value(value), msg);
+    else if (const size_t count = take_flags(flags, true))
+        read_value(taken_value(count - 1), value);
+    return value;
+}
+
+template <typename Options>
+void parse_options(void* options)
+{
+    static_cast<Options*>(options)->parse();
+}
+
+template <typename Options>
+bool parse_option_group(Options& options)
+{
+    const OptionGroup group = { Options::specs(), Options::strings(), parse_options<Options>, &options };
+    return add_option_group(group);
+}
+
+template <typename T>
+bool bind_arg(T* value)
+{
+    StringRef arg;
+    if (!take_arg(arg))
+        return false;
+    read_value(arg, *value);
+    return true;
+}
+
+template <typename T>
+T parse_arg(T value)
+{
+    bind_arg(&value);
+    return value;
+}
 
 } // namespace ap
 
@@ -26,6 +26,10 @@ int option_main(int argc, char* argv[]);
 
 #include "arg-parser.h"
 
+#include <iostream>
+#include <sstream>
+#include <vector>
+
 int main(int argc, char* argv[])
 {
     // 1. Simple usage in 'main'
@@ -36,7 +40,7 @@ int main(int argc, char* argv[])
     uint a_size           = PARSE_FLAG("--size SIZE[=%d]", 300, "set size of window.");
     float a_lineWidth     = PARSE_FLAG("-w, --line-width LW", 3.14f, "set width of line. Default is '%d'.");
     std::string a_path    = PARSE_FLAG("-p, --path PATH", std::string("./build"), "set working dir. Default is '%d'.");
-    const char a_dot      = CHECK_FLAG("-d", argc, argv) ? PARSE_FLAG("-d DOT", '.', "set separate char. Default is '%d'.") : '\0';
+    const char a_dot      = HAS_FLAG("-d") ? PARSE_FLAG("-d DOT", '.', "set separate char. Default is '%d'.") : '\0';
     bool a_enable         = PARSE_FLAG("-e, --enable", false, "enable something.");
     bool a_none           = PARSE_FLAG("-none", true, "disable something.");
     ADD_MSG("\nFrequencies:");
@@ -91,19 +95,21 @@ public:
         ap::s_alignment = 30;
         std::string usage("Arg-parser Demo *** Singleton version *** (C) 2018. Szilard Ledan\nUsage: %p [options] name number [number...]\n\nOptions:");
         m_help      = PARSE_HELP("-h, --help, --usage", "show this help.", usage, argc, argv);
-        /* Parse flags. */
-        m_frequency = PARSE_FLAG("-f, --frequency FREQ", 60, "set rendering frequency.\n Default is '%d', but '%d' is not the best.");
-        m_Frequency = PARSE_FLAG("+f, ++frequency FREQ", 25, "set refreshing frequency. Default is '%d'.");
-        m_size      = PARSE_FLAG("--size SIZE", 300, "set size of window. Default is '%d'.");
-        m_lineWidth = PARSE_FLAG("-w, --line-width LW", 3.14f, "set width of line. Default is '%d'.");
-        m_path      = PARSE_FLAG("-p, --path PATH", std::string("./build"), "set working dir. Default is '%d'.");
-        m_dot       = PARSE_FLAG("-d DOT", '.', "set separate char. Default is '%d'.");
-        m_enable    = PARSE_FLAG("-e, --enable", false, "enable something.");
-        /* Parse arguments. */
-        m_from      = PARSE_ARG(m_from);
-        m_to.push_back(PARSE_ARG(3));
+        /* Bind flags, the initializers of the members are the defaults. */
+        BIND_FLAG("-f, --frequency FREQ", &m_frequency, "set rendering frequency.\n Default is '%d', but '%d' is not the best.");
+        BIND_FLAG("+f, ++frequency FREQ", &m_Frequency, "set refreshing frequency. Default is '%d'.");
+        BIND_FLAG("--size SIZE", &m_size, "set size of window. Default is '%d'.");
+        BIND_FLAG("-w, --line-width LW", &m_lineWidth, "set width of line. Default is '%d'.");
+        BIND_FLAG("-p, --path PATH", &m_path, "set working dir. Default is '%d'.");
+        BIND_FLAG("-d DOT", &m_dot, "set separate char. Default is '%d'.");
+        BIND_FLAG("-e, --enable", &m_enable, "enable something.");
+        /* Bind arguments. */
+        BIND_ARG(&m_from);
+        m_to.push_back(3);
+        BIND_ARG(&m_to.back());
         while (!m_help && UNPARSED_COUNT()) {
-            m_to.push_back(PARSE_ARG(0));
+            m_to.emplace_back();
+            BIND_ARG(&m_to.back());
         }
 
         return *this;
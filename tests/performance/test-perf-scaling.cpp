@@ -0,0 +1,300 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test-perf.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+#include <string>
+#include <vector>
+
+namespace testargparse {
+namespace {
+
+const size_t s_runs = 5;
+const size_t s_growth = 16;
+const double s_linearSlack = 3.0; /*< A quadratic cost would be 16 times more than linear. */
+
+struct Argv {
+    explicit Argv(size_t count, const std::string& prefix = "arg-", const char* flag = nullptr)
+    {
+        storage.push_back("prog");
+        for (size_t i = 0; i < count; ++i) {
+            if (flag)
+                storage.push_back(flag);
+            storage.push_back(prefix + std::to_string(i));
+        }
+        for (const auto& arg : storage)
+            argv.push_back(arg.c_str());
+    }
+
+    int argc() const { return int(argv.size()); }
+
+    std::vector<std::string> storage;
+    std::vector<const char*> argv;
+};
+
+/*! \brief Return the ratio of the cost per item of 'count' and 's_growth * count' items */
+double scaling(TestContext* ctx, const size_t& count, const std::function<void(const Argv&)>& func)
+{
+    const Argv small(count);
+    const Argv large(s_growth * count);
+    const double smallNs = ctx->measure(s_runs, [&]() { func(small); });
+    const double largeNs = ctx->measure(s_runs, [&]() { func(large); });
+    return largeNs / (s_growth * smallNs);
+}
+
+void parseArgs(const Argv& args)
+{
+    PARSE_HELP("-h, --help", "", "", args.argc(), args.argv.data());
+    while (UNPARSED_COUNT())
+        PARSE_ARG(std::string());
+}
+
+void checkFlag(const Argv& args)
+{
+    CHECK_FLAG("-m, --missing", args.argc(), args.argv.data());
+}
+
+TestContext::Return testPositionalScaling(TestContext* ctx)
+{
+    const double ratio = scaling(ctx, 10000, parseArgs);
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "Parsing 16 times more arguments is " + std::to_string(ratio) + " times slower per argument.");
+
+    const Argv args(100000);
+    if (TAP_BENCH(ctx, "parse-arg-100k", s_runs, parseArgs(args)))
+        return TAP_FAIL(ctx, "Parsing 100k arguments is slower than the baseline.");
+
+    return TAP_PASS(ctx, "Positional arguments are parsed in linear time.");
+}
+
+TestContext::Return testCheckFlagScaling(TestContext* ctx)
+{
+    const double ratio = scaling(ctx, 10000, checkFlag);
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "Checking 16 times more arguments is " + std::to_string(ratio) + " times slower per argument.");
+
+    const Argv args(100000);
+    if (TAP_BENCH(ctx, "check-flag-100k", s_runs, checkFlag(args)))
+        return TAP_FAIL(ctx, "Checking 100k arguments is slower than the baseline.");
+
+    return TAP_PASS(ctx, "CHECK_FLAG runs in linear time.");
+}
+
+TestContext::Return testFlagScaling(TestContext* ctx)
+{
+    std::vector<std::string> specs;
+    for (size_t i = 0; i < s_growth * 1000; ++i)
+        specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i));
+    // The flags are defined in the reverse order of argv, and the missing ones are looked up too.
+    auto parseFlags = [&](const Argv& args) {
+        PARSE_HELP("-h, --help", "", "", args.argc(), args.argv.data());
+        PARSE_FLAG("-m, --missing", false, "");
+        for (size_t i = args.storage.size() - 1; i; --i)
+            PARSE_FLAG(specs[i - 1], false, "");
+    };
+
+    const Argv small(1000, "--flag-");
+    const Argv large(s_growth * 1000, "--flag-");
+    const double ratio = ctx->measure(s_runs, [&]() { parseFlags(large); }) / (s_growth * ctx->measure(s_runs, [&]() { parseFlags(small); }));
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "Parsing 16 times more flags is " + std::to_string(ratio) + " times slower per flag.");
+
+    const Argv args(10000, "--flag-");
+    if (TAP_BENCH(ctx, "parse-flag-10k", s_runs, parseFlags(args)))
+        return TAP_FAIL(ctx, "Parsing 10k flags is slower than the baseline.");
+
+    return TAP_PASS(ctx, "Flags are parsed in linear time.");
+}
+
+TestContext::Return testRepeatedFlagScaling(TestContext* ctx)
+{
+    auto parseIncludes = [](const Argv& args) {
+        PARSE_HELP("-h, --help", "", "", args.argc(), args.argv.data());
+        PARSE_FLAG_ALL("-I, --include DIR", std::vector<ap::StringRef>(), "");
+    };
+
+    const Argv small(1000, "dir-", "-I");
+    const Argv large(s_growth * 1000, "dir-", "-I");
+    const double ratio = ctx->measure(s_runs, [&]() { parseIncludes(large); }) / (s_growth * ctx->measure(s_runs, [&]() { parseIncludes(small); }));
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "Collecting 16 times more occurrences is " + std::to_string(ratio) + " times slower per occurrence.");
+
+    const Argv args(100000, "dir-", "-I");
+    if (TAP_BENCH(ctx, "parse-flag-all-100k", s_runs, parseIncludes(args)))
+        return TAP_FAIL(ctx, "Collecting 100k occurrences is slower than the baseline.");
+
+    return TAP_PASS(ctx, "Repeated flags are collected in linear time.");
+}
+
+TestContext::Return testHelpScaling(TestContext* ctx)
+{
+    const char* argv[] = { "prog", "--help" };
+    std::vector<std::string> specs;
+    for (size_t i = 0; i < s_growth * 1000; ++i)
+        specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i) + " VALUE");
+    auto help = [&](size_t count) {
+        std::string page;
+        PARSE_HELP("-h, --help", "show this help.", "Usage: %p", TAP_ARRAY_SIZE(argv), argv);
+        for (size_t i = 0; i < count; ++i)
+            PARSE_FLAG(specs[i], 0, "set a flag, it has a long description which is wrapped. Default is '%d'.");
+        ap::take_help_page(page);
+    };
+
+    const double ratio = ctx->measure(s_runs, [&]() { help(s_growth * 1000); }) / (s_growth * ctx->measure(s_runs, [&]() { help(1000); }));
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "The help of 16 times more flags is " + std::to_string(ratio) + " times slower per flag.");
+
+    if (TAP_BENCH(ctx, "help-10k", s_runs, help(10000)))
+        return TAP_FAIL(ctx, "The help of 10k flags is slower than the baseline.");
+
+    return TAP_PASS(ctx, "The help page is made in linear time.");
+}
+
+TestContext::Return testEditScaling(TestContext* ctx)
+{
+    // A keystroke replaces the word in the middle of the line, the other words are not parsed again.
+    const char* words[] = { "--mode=fast", "--mode=faster" };
+    const size_t edits = 100;
+    auto edit = [&](std::vector<const char*>& argv) {
+        const size_t middle = argv.size() / 2;
+        for (size_t i = 0; i < edits; ++i) {
+            argv[middle] = words[i % 2];
+            PARSE_EDIT("-h, --help", "", "", int(argv.size()), argv.data(), middle, 1);
+            PARSE_FLAG("-m, --mode MODE", std::string(), "");
+            UNPARSED_COUNT();
+        }
+    };
+
+    const Argv storage(s_growth * 1000);
+    std::vector<const char*> small(storage.argv.begin(), storage.argv.begin() + 1001);
+    std::vector<const char*> large(storage.argv);
+    const double smallNs = ctx->measure(s_runs, [&]() { edit(small); });
+    const double ratio = ctx->measure(s_runs, [&]() { edit(large); }) / smallNs;
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "An edit of a 16 times longer line is " + std::to_string(ratio) + " times slower.");
+
+    const Argv line(100000);
+    std::vector<const char*> args(line.argv);
+    if (TAP_BENCH(ctx, "parse-edit-100k", s_runs, edit(args)))
+        return TAP_FAIL(ctx, "Editing a line of 100k arguments is slower than the baseline.");
+
+    return TAP_PASS(ctx, "An edit is parsed in constant time.");
+}
+
+TestContext::Return testEditCountScaling(TestContext* ctx)
+{
+    // A space typed in the middle word splits it, a backspace joins it again. The tokens after
+    // the edit are moved and the index is renumbered, so these edits are linear in the line,
+    // but they do not split and index the line again like a full parse.
+    const size_t edits = 100;
+    auto edit = [&](std::vector<const char*>& argv) {
+        const size_t middle = argv.size() / 2;
+        for (size_t i = 0; i < edits; ++i) {
+            const bool splitting = i % 2 == 0;
+            if (splitting)
+                argv.insert(argv.begin() + middle + 1, "fast");
+            else
+                argv.erase(argv.begin() + middle + 1);
+            argv[middle] = splitting ? "--mode=" : "--mode=fast";
+            PARSE_EDIT("-h, --help", "", "", int(argv.size()), argv.data(), middle, splitting ? 1 : 2);
+            PARSE_FLAG("-m, --mode MODE", std::string(), "");
+            UNPARSED_COUNT();
+        }
+    };
+    auto parse = [&](std::vector<const char*>& argv) {
+        for (size_t i = 0; i < edits; ++i) {
+            PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+            PARSE_FLAG("-m, --mode MODE", std::string(), "");
+            UNPARSED_COUNT();
+        }
+    };
+
+    const Argv storage(s_growth * 1000);
+    std::vector<const char*> small(storage.argv.begin(), storage.argv.begin() + 1001);
+    std::vector<const char*> large(storage.argv);
+    const double smallNs = ctx->measure(s_runs, [&]() { edit(small); });
+    const double largeNs = ctx->measure(s_runs, [&]() { edit(large); });
+    const double ratio = largeNs / (s_growth * smallNs);
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "An edit changing the word count of a 16 times longer line is " + std::to_string(ratio) + " times slower per word.");
+    const double parseNs = ctx->measure(s_runs, [&]() { parse(large); });
+    if (TAP_CHECK(ctx, largeNs > parseNs / 2))
+        return TAP_FAIL(ctx, "An edit changing the word count costs " + std::to_string(largeNs / parseNs) + " of a full parse.");
+
+    const Argv line(100000);
+    std::vector<const char*> args(line.argv);
+    if (TAP_BENCH(ctx, "parse-edit-split-100k", s_runs, edit(args)))
+        return TAP_FAIL(ctx, "Splitting a word of a line of 100k arguments is slower than the baseline.");
+
+    return TAP_PASS(ctx, "An edit changing the word count is parsed in linear time, cheaper than a full parse.");
+}
+
+TestContext::Return testSuggestionScaling(TestContext* ctx)
+{
+    std::vector<std::string> specs;
+    for (size_t i = 0; i < s_growth * 1000; ++i)
+        specs.push_back("-f" + std::to_string(i) + ", --flag-" + std::to_string(i) + " VALUE");
+    const char* clean[] = { "prog", "--flag-1" };
+    const char* typo[] = { "prog", "--flag-1", "--flga-2" };
+    // The suggestion is looked up among all aliases only when the errors are formatted.
+    auto parse = [&](size_t count, const char** argv, int argc) {
+        PARSE_HELP("-h, --help", "", "", argc, argv);
+        for (size_t i = 0; i < count; ++i)
+            PARSE_FLAG(specs[i], 0, "");
+        if (FINISH_PARSE())
+            FORMAT_ERRORS();
+    };
+
+    const double ratio = ctx->measure(s_runs, [&]() { parse(s_growth * 1000, typo, TAP_ARRAY_SIZE(typo)); }) / (s_growth * ctx->measure(s_runs, [&]() { parse(1000, typo, TAP_ARRAY_SIZE(typo)); }));
+    if (TAP_CHECK(ctx, ratio > s_linearSlack))
+        return TAP_FAIL(ctx, "A suggestion among 16 times more flags is " + std::to_string(ratio) + " times slower per flag.");
+    const double cleanNs = ctx->measure(s_runs, [&]() { parse(10000, clean, TAP_ARRAY_SIZE(clean)); });
+    const double typoNs = ctx->measure(s_runs, [&]() { parse(10000, typo, TAP_ARRAY_SIZE(typo)); });
+    if (TAP_CHECK(ctx, typoNs > 2 * cleanNs))
+        return TAP_FAIL(ctx, "A parse of 10k flags with a typo is " + std::to_string(typoNs / cleanNs) + " times slower than without.");
+
+    if (TAP_BENCH(ctx, "suggest-10k", s_runs, parse(10000, typo, TAP_ARRAY_SIZE(typo))))
+        return TAP_FAIL(ctx, "A suggestion among 10k flags is slower than the baseline.");
+
+    return TAP_PASS(ctx, "A suggestion is looked up in linear time, on the error path only.");
+}
+
+} // namespace anonymous
+
+void perfScalingTests(TestContext* ctx)
+{
+    ctx->add(testPositionalScaling, TestContext::Serial);
+    ctx->add(testCheckFlagScaling, TestContext::Serial);
+    ctx->add(testFlagScaling, TestContext::Serial);
+    ctx->add(testRepeatedFlagScaling, TestContext::Serial);
+    ctx->add(testHelpScaling, TestContext::Serial);
+    ctx->add(testEditScaling, TestContext::Serial);
+    ctx->add(testEditCountScaling, TestContext::Serial);
+    ctx->add(testSuggestionScaling, TestContext::Serial);
+}
+
+} // namespace testargparse
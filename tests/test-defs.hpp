@@ -55,6 +55,11 @@
 #endif // TAP_CHECK
 #define TAP_CHECK(CTX, COND) CTX->check((COND))
 
+#ifdef TAP_BENCH
+#undef TAP_BENCH
+#endif // TAP_BENCH
+#define TAP_BENCH(CTX, NAME, RUNS, CODE) CTX->bench(NAME, RUNS, [&]() { CODE; })
+
 #ifdef TAP_CHARS
 #undef TAP_CHARS
 #endif // TAP_CHARS
@@ -24,45 +24,26 @@
 
 #include "test.hpp"
 
-#include "api/test-api.hpp"
-#include "manual/test-manual.hpp"
+#include "performance/test-perf.hpp"
 #include "unit-and-behavior/test-unit.hpp"
 
 namespace testargparse {
 
-void apiTests(TestContext* ctx)
+void performanceTests(TestContext* ctx)
 {
-    testargparse::apiArgStructTests(ctx);
-    testargparse::apiCheckAndReadTests(ctx);
-    testargparse::apiCheckTests(ctx);
-    testargparse::apiConstructorsTests(ctx);
-    testargparse::apiDefTests(ctx);
-    testargparse::apiFlagStructTests(ctx);
-    testargparse::apiOperatorTests(ctx);
-    testargparse::apiParserTests(ctx);
-    testargparse::apiValueStructTests(ctx);
-}
-
-void manualTests(TestContext* ctx)
-{
-    testargparse::manualHelpTests(ctx);
-    testargparse::manualErrorTests(ctx);
+    testargparse::perfScalingTests(ctx);
 }
 
 void unitAndBehaviorTests(TestContext* ctx)
 {
-    testargparse::unitArgStructTests(ctx);
-    testargparse::unitCheckAndReadTests(ctx);
-    testargparse::unitCheckTests(ctx);
-    testargparse::unitConstructorsTests(ctx);
-    testargparse::unitCountsTests(ctx);
-    testargparse::unitDefTests(ctx);
+    testargparse::unitCommandsTests(ctx);
+    testargparse::unitCompletionTests(ctx);
+    testargparse::unitConfigTests(ctx);
+    testargparse::unitDeclaredOptionsTests(ctx);
     testargparse::unitErrorsTests(ctx);
-    testargparse::unitFlagStructTests(ctx);
-    testargparse::unitOperatorTests(ctx);
-    testargparse::unitOptionsTests(ctx);
-    testargparse::unitParserTests(ctx);
-    testargparse::unitValueStructTests(ctx);
+    testargparse::unitMacrosTests(ctx);
+    testargparse::unitPatternsTests(ctx);
+    testargparse::unitStatsTests(ctx);
 }
 
 } // namespace testargparse
@@ -24,7 +24,8 @@
 
 #include "test.hpp"
 
-#include "arg-parse.hpp"
+#include "arg-parser.h"
+#include <cstdio>
 #include <iostream>
 
 // Configure and run tests.
@@ -32,72 +33,61 @@
 int main(int argc, char* argv[])
 {
     struct {
-        const bool nonSpecified() const { return !api && !unit && ! manual; }
+        const bool nonSpecified() const { return !perf && !unit; }
         bool all = false;
-        bool api = false;
+        bool perf = false;
         bool silent = false;
         bool unit = false;
-        bool manual = false;
-        std::string manualValue = "";
     } options;
 
+    // Create test context.
+    testargparse::TestContext::Param param;
+
     // Parse arguments.
     {
-        using namespace argparse;
-        ArgParse args;
-
-        // Define options.
-        args.def(Flag("--api", "-a", "Select api tests."));
-        Value helpTestConfigs = Value("program.name=show-help"
-                                      ",mode.strict=true"
-                                      ",help.add=true"
-                                      ",help.tab=\t"
-                                      ",help.compact=on"
-                                      ",help.margin=26"
-                                      ",help.show=2" /*< Default value. */,
-                                      !Value::Required, /*< Set non required. */
-                                      "options" /*< Name of value. */,
-                                      "This value is interlaced, see more: ArgParse Api Reference." /*< Description of value. */);
-        args.def(Flag("--manual", "-m", "Select manual tests.", helpTestConfigs));
-        args.def(Flag("--unit", "-u", "Select unit tests."));
-        args.def(Flag("--silent", "-s", "Fails show only."));
-
-        // Parse argv and argc and check errors.
-        if (!args.parse(argc, argv)) {
-            std::cout << args.error() << std::endl;
-            std::cout << args.help() << std::endl;
+        const bool help = PARSE_HELP("-h, --help", "Show this help.", "Usage: %p [options]\n\nOptions:", argc, argv);
+        options.all = PARSE_FLAG("-a, --all", false, "Select all tests (default).");
+        options.perf = PARSE_FLAG("-p, --perf", false, "Select performance tests.");
+        options.unit = PARSE_FLAG("-u, --unit", false, "Select unit tests.");
+        options.silent = PARSE_FLAG("-s, --silent", false, "Fails show only.");
+        param.baseline = PARSE_FLAG("-b, --baseline FILE", std::string(), "Compare the benchmarks with FILE, the missing ones are stored into it.");
+        param.tolerance = PARSE_FLAG("-t, --tolerance PERCENT", 50.0, "Allowed slowdown against the baseline. Default is %d%.") / 100.0;
+        param.updateBaseline = PARSE_FLAG("--update-baseline", false, "Store every benchmark into the baseline file.");
+        param.jobs = PARSE_FLAG("-j, --jobs COUNT", size_t(0), "Threads of the parallel tests, 0 means one per core. Default is %d.");
+        param.slowest = PARSE_FLAG("--slowest COUNT", size_t(5), "Show the COUNT slowest tests, 0 hides them. Default is %d.");
+        const std::string shard = PARSE_FLAG("--shard I/N", std::string("1/1"), "Run only the I-th of N equal parts of the tests. Default is %d.");
+        param.isolate = PARSE_FLAG("-i, --isolate", false, "Run every test in its own process, a crash fails only that test.");
+        param.timeout = PARSE_FLAG("--timeout SECONDS", 0.0, "Kill an isolated test after SECONDS, 0 means no limit (implies --isolate).");
+
+        // Check help flags and errors.
+        if (help) {
+            FLUSH_HELP();
+            return 0;
+        }
+        if (UNPARSED_COUNT()) {
+            std::cout << "Unknown arguments, see '" << argv[0] << " --help'." << std::endl;
             return 1;
         }
 
-        // Check help flags.
-        if (args["--help"].isSet) {
-            std::cout << args.help() << std::endl;
-            return 0;
+        size_t index = 0, count = 0;
+        char end = 0;
+        if (std::sscanf(shard.c_str(), "%zu/%zu%c", &index, &count, &end) != 2 || !index || index > count) {
+            std::cout << "Invalid shard '" << shard << "', it has to be I/N with 1 <= I <= N." << std::endl;
+            return 1;
         }
-
-        // Collect options.
-        options.all = args["--all"].isSet;
-        options.api = args["--api"].isSet;
-        options.silent = args["--silent"].isSet;
-        options.unit = args["--unit"].isSet;
-        if ((options.manual = args["--manual"].isSet))
-            options.manualValue = args["--manual"].value.str;
+        param.shardIndex = index - 1;
+        param.shardCount = count;
+        param.isolate = param.isolate || param.timeout > 0;
     }
 
-    // Create test context.
     testargparse::TestContext ctx(!options.silent);
+    ctx.param = param;
 
     const bool all = options.all || options.nonSpecified();
 
-    // Run manual tests.
-    if (options.manual || all) {
-        ctx.param.str = options.manualValue;
-        testargparse::manualTests(&ctx);
-    }
-
-    // Collect api tests.
-    if (options.api || all) {
-        testargparse::apiTests(&ctx);
+    // Collect performance tests.
+    if (options.perf || all) {
+        testargparse::performanceTests(&ctx);
     }
 
     // Collect unit and behavior tests.
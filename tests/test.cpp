@@ -24,20 +24,38 @@
 
 #include "test.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define TAP_HAS_FORK 1
+#endif // defined(__unix__) || defined(__APPLE__)
 
 namespace testargparse {
 
 // Util functions.
 namespace {
 
-#include <math.h>
-
 inline float perCent(const size_t& counter, const size_t& denom, const float& precision = 100.0f)
 {
-    return (denom * precision) ? trunc(float(counter) / float(denom) * precision * 100.0f) / precision : 0.0f;
+    return (denom && precision) ? std::trunc(float(counter) / float(denom) * precision * 100.0f) / precision : 0.0f;
 }
 
+// The record of the test running on this thread, nullptr outside of tests.
+thread_local void* s_record = nullptr;
+
 } // namespace anonymous
 
 // TestContext
@@ -49,31 +67,96 @@ TestContext::TestContext(const bool& showPass)
     _result << std::endl << "Ready to collecting tests." << std::endl;
 }
 
-void TestContext::add(TestContext::TestInstanceFunc test)
+void TestContext::add(TestContext::TestInstanceFunc test, const Mode& mode)
 {
-    _tests.insert(test);
+    _tests.insert(std::make_pair(test, mode));
 }
 
 int TestContext::run()
 {
-    const size_t nums = _tests.size();
+    std::vector<std::pair<size_t, std::pair<TestInstanceFunc, Mode>>> selected;
+    size_t testIndex = 0;
+    for (const auto& test : _tests) {
+        if (testIndex % std::max(param.shardCount, size_t(1)) == param.shardIndex)
+            selected.push_back(std::make_pair(testIndex, test));
+        ++testIndex;
+    }
+
+    const size_t nums = selected.size();
     size_t pass = 0;
     size_t nott = 0;
 
     if (nums) {
-        _result << std::endl << "Run " << nums << " collected test(s)!" << std::endl;
+        _result << std::endl << "Run " << nums << " collected test(s)";
+        if (param.shardCount > 1)
+            _result << " of shard " << param.shardIndex + 1 << "/" << param.shardCount << " (" << _tests.size() << " in all)";
+        _result << "!" << std::endl;
+        if (param.isolate)
+            _result << "Every test runs in its own process." << std::endl;
         if (!_showPass)
             _result << "Passes does not show." << std::endl;
         _result << std::endl;
 
-        for (auto test : _tests) {
-            switch (test(this)) {
+        std::vector<Record> records(nums);
+        std::vector<Record*> parallel;
+        size_t index = 0;
+        for (const auto& test : selected) {
+            Record& record = records[index++];
+            record.index = test.first;
+            record.func = test.second.first;
+            record.mode = test.second.second;
+            record.seconds = 0;
+            record.checksPass = record.checksFail = 0;
+            if (record.mode == Parallel)
+                parallel.push_back(&record);
+        }
+
+        // The serial tests run alone, then the parallel ones on a pool of threads.
+        for (auto& record : records)
+            if (record.mode == Serial)
+                param.isolate ? runIsolated(record) : runRecord(record);
+
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < parallel.size(); i = next++)
+                param.isolate ? runIsolated(*parallel[i]) : runRecord(*parallel[i]);
+        };
+        const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+        const size_t jobs = std::min(param.jobs ? param.jobs : cores, std::max(parallel.size(), size_t(1)));
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < jobs; ++i)
+            threads.push_back(std::thread(worker));
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+
+        for (const auto& record : records) {
+            _result << record.result.str();
+            _checks.pass += record.checksPass;
+            _checks.fail += record.checksFail;
+            switch (record.ret) {
             case Return::Pass: pass++; break;
             case Return::NotTested: nott++; break;
             default: break;
             }
         }
 
+        if (param.slowest) {
+            std::vector<const Record*> slowest;
+            for (const auto& record : records)
+                slowest.push_back(&record);
+            std::sort(slowest.begin(), slowest.end(), [](const Record* a, const Record* b) { return a->seconds > b->seconds; });
+            slowest.resize(std::min(slowest.size(), param.slowest));
+            _result << std::endl << "Slowest " << slowest.size() << " test(s) on " << jobs << " thread(s):" << std::endl;
+            for (const auto record : slowest) {
+                std::ostringstream millis;
+                millis << std::fixed << std::setprecision(2) << std::setw(9) << record->seconds * 1000.0;
+                _result << "  " << millis.str() << " ms " << (record->mode == Serial ? "(serial) " : "") << record->name << std::endl;
+            }
+        }
+
+        storeBaseline();
+
 #define TAP_WRITE_RESULT(R, N, C) \
     R << "/" << N << " (" << perCent(R, N) << "%) where were " << C << "/" << _checks.sum() << " (" << perCent(C, _checks.sum() ? _checks.sum() : 1) << "%) checks."
 
@@ -86,44 +169,279 @@ int TestContext::run()
         std::clog << _result.str();
     }
 
-    return pass == nums ? 0 : 1;
+    return pass + nott == nums ? 0 : 1;
 }
 
 TestContext::Return TestContext::pass(const std::string& msg, const std::string& file, const std::string& func, const std::string& line)
 {
+    label(file, func, line);
     if (_showPass) {
         this->test(file, func, line);
-        _result << "\033[32;1m" << "  PASS" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
+        out() << "\033[32;1m" << "  PASS" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
     }
     return Return::Pass;
 }
 
 TestContext::Return TestContext::fail(const std::string& msg, const std::string& file, const std::string& func, const std::string& line)
 {
+    label(file, func, line);
     this->test(file, func, line);
-    _result << "\033[31;1m" << "  FAIL" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
+    out() << "\033[31;1m" << "  FAIL" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
     return Return::Fail;
 }
 
 const bool& TestContext::check(const bool& condition)
 {
+    Record* record = static_cast<Record*>(s_record);
     if (condition)
-        _checks.fail++;
+        (record ? record->checksFail : _checks.fail)++;
     else
-        _checks.pass++;
+        (record ? record->checksPass : _checks.pass)++;
     return condition;
 }
 
 TestContext::Return TestContext::nott(const std::string& msg, const std::string& file, const std::string& func, const std::string& line)
 {
+    label(file, func, line);
     this->test(file, func, line);
-    _result << "\033[33;1m" << "  NOT TESTED" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
+    out() << "\033[33;1m" << "  NOT TESTED" << "\033[39m\033[22m\033[49m: " << msg << std::endl;
     return Return::NotTested;
 }
 
+double TestContext::measure(const size_t& runs, const std::function<void()>& func)
+{
+    std::vector<double> samples;
+    func(); // Warm up.
+    for (size_t i = 0; i < std::max(runs, size_t(1)); ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        func();
+        samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+bool TestContext::bench(const std::string& name, const size_t& runs, const std::function<void()>& func)
+{
+    const double median = measure(runs, func);
+    std::lock_guard<std::mutex> lock(_benchMutex);
+    _medians[name] = median;
+    loadBaseline();
+
+    const auto baseline = _baseline.find(name);
+    const bool slower = baseline != _baseline.end() && median > baseline->second * (1.0 + param.tolerance);
+    if (_showPass || slower) {
+        out() << "  BENCH " << name << ": " << median << " ns";
+        if (baseline != _baseline.end())
+            out() << " (baseline " << baseline->second << " ns)";
+        out() << std::endl;
+    }
+    return check(slower);
+}
+
+void TestContext::loadBaseline()
+{
+    if (_baselineLoaded || param.baseline.empty())
+        return;
+    _baselineLoaded = true;
+
+    std::ifstream file(param.baseline);
+    std::string name;
+    double median;
+    while (file >> name >> median)
+        _baseline[name] = median;
+}
+
+void TestContext::storeBaseline()
+{
+    if (param.baseline.empty() || _medians.empty())
+        return;
+
+    bool changed = false;
+    for (const auto& median : _medians)
+        if (param.updateBaseline || !_baseline.count(median.first)) {
+            _baseline[median.first] = median.second;
+            changed = true;
+        }
+    if (!changed)
+        return;
+
+    std::ofstream file(param.baseline);
+    for (const auto& baseline : _baseline)
+        file << baseline.first << " " << baseline.second << std::endl;
+    _result << std::endl << "Baseline is stored to " << param.baseline << "." << std::endl;
+}
+
+void TestContext::runRecord(Record& record)
+{
+    s_record = &record;
+    const auto begin = std::chrono::steady_clock::now();
+    record.ret = record.func(this);
+    record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    s_record = nullptr;
+}
+
+#if defined(TAP_HAS_FORK)
+
+namespace {
+
+template<typename T>
+void writeValue(std::string& data, const T& value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeString(std::string& data, const std::string& str)
+{
+    writeValue(data, str.size());
+    data.append(str);
+}
+
+template<typename T>
+bool readValue(const std::string& data, size_t& pos, T& value)
+{
+    if (data.size() - pos < sizeof(value))
+        return false;
+    std::memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+bool readString(const std::string& data, size_t& pos, std::string& str)
+{
+    size_t size;
+    if (!readValue(data, pos, size) || data.size() - pos < size)
+        return false;
+    str.assign(data, pos, size);
+    pos += size;
+    return true;
+}
+
+} // namespace anonymous
+
+/*! The child runs the test and writes the record and its benchmark medians into a pipe,
+ *  the parent reads them until the child exits or the timeout kills it.
+ */
+void TestContext::runIsolated(Record& record)
+{
+    // The pipe is made and its write end closed in the parent while no other test forks, so
+    // only the child of this test can hold the write end, and its exit ends the read.
+    std::unique_lock<std::mutex> forkLock(_forkMutex);
+    int fds[2];
+    if (pipe(fds)) {
+        forkLock.unlock();
+        runRecord(record);
+        return;
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if (!pid) {
+        close(fds[0]);
+        _medians.clear();
+        runRecord(record);
+        std::string data;
+        writeValue(data, record.ret);
+        writeValue(data, record.checksPass);
+        writeValue(data, record.checksFail);
+        writeString(data, record.name);
+        writeString(data, record.result.str());
+        writeValue(data, _medians.size());
+        for (const auto& median : _medians) {
+            writeString(data, median.first);
+            writeValue(data, median.second);
+        }
+        for (size_t pos = 0; pos < data.size();) {
+            const ssize_t written = write(fds[1], data.data() + pos, data.size() - pos);
+            if (written <= 0)
+                break;
+            pos += written;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    forkLock.unlock();
+
+    std::string data;
+    bool timedOut = false;
+    char buffer[4096];
+    while (pid > 0) {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (param.timeout > 0 && elapsed >= param.timeout) {
+            timedOut = true;
+            kill(pid, SIGKILL);
+            break;
+        }
+        pollfd poller = { fds[0], POLLIN, 0 };
+        if (poll(&poller, 1, param.timeout > 0 ? int((param.timeout - elapsed) * 1000.0) + 1 : -1) <= 0)
+            continue;
+        const ssize_t size = read(fds[0], buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        data.append(buffer, size);
+    }
+    close(fds[0]);
+    int status = 0;
+    if (pid > 0)
+        waitpid(pid, &status, 0);
+    record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    size_t pos = 0;
+    std::string result;
+    size_t count = 0;
+    const bool ok = !timedOut && readValue(data, pos, record.ret) && readValue(data, pos, record.checksPass)
+        && readValue(data, pos, record.checksFail) && readString(data, pos, record.name) && readString(data, pos, result)
+        && readValue(data, pos, count);
+    for (size_t i = 0; ok && i < count; ++i) {
+        std::string name;
+        double median;
+        if (readString(data, pos, name) && readValue(data, pos, median)) {
+            std::lock_guard<std::mutex> lock(_benchMutex);
+            _medians[name] = median;
+        }
+    }
+    record.result << result;
+
+    if (!ok) {
+        std::ostringstream reason;
+        if (timedOut)
+            reason << "Killed after the timeout of " << param.timeout << " seconds.";
+        else if (pid > 0 && WIFSIGNALED(status))
+            reason << "Crashed with signal " << WTERMSIG(status) << ".";
+        else
+            reason << "The test process did not report a result.";
+        record.ret = Return::Fail;
+        ++record.checksFail;
+        if (record.name.empty())
+            record.name = "test " + std::to_string(record.index + 1) + " of " + std::to_string(_tests.size());
+        record.result << "The " << record.name << std::endl;
+        record.result << "\033[31;1m" << "  FAIL" << "\033[39m\033[22m\033[49m: " << reason.str() << std::endl;
+    }
+}
+
+#else // !defined(TAP_HAS_FORK)
+
+void TestContext::runIsolated(Record& record)
+{
+    runRecord(record);
+}
+
+#endif // defined(TAP_HAS_FORK)
+
+std::ostream& TestContext::out()
+{
+    return s_record ? static_cast<Record*>(s_record)->result : _result;
+}
+
+void TestContext::label(const std::string& file, const std::string& func, const std::string& line)
+{
+    if (s_record)
+        static_cast<Record*>(s_record)->name = func + "() at " + file + ":" + line;
+}
+
 inline void TestContext::test(const std::string& file, const std::string& func, const std::string& line)
 {
-    _result << "The " << func  << "() at " << file << ":" << line << std::endl;
+    out() << "The " << func  << "() at " << file << ":" << line << std::endl;
 }
 
 } // namespace testargparse
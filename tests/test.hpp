@@ -27,20 +27,23 @@
 
 #include "test-defs.hpp"
 
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 #include <sstream>
-#include <set>
 
 namespace testargparse {
 
 class TestContext {
 public:
     enum Return { Fail, Pass, NotTested };
+    enum Mode { Parallel, Serial }; /*< Serial tests run alone, before the parallel ones. */
     typedef Return (*TestInstanceFunc)(TestContext*);
 
     TestContext(const bool& = true);
 
-    void add(TestInstanceFunc);
+    void add(TestInstanceFunc, const Mode& = Parallel);
     int run();
 
     Return pass(const std::string& msg, const std::string& file, const std::string& func, const std::string& line);
@@ -48,12 +51,48 @@ public:
     Return nott(const std::string& msg, const std::string& file, const std::string& func, const std::string& line);
     const bool& check(const bool& condition);
 
+    /*! \brief Return the median nanoseconds of 'runs' calls of 'func' */
+    double measure(const size_t& runs, const std::function<void()>& func);
+    /*! \brief Measure 'func' and check that its median is at most the baseline of 'name' plus the tolerance
+     *
+     *  Returns true (a failed check) if it is slower. A missing baseline is stored by run().
+     */
+    bool bench(const std::string& name, const size_t& runs, const std::function<void()>& func);
+
     struct Param {
         std::string str;
+        std::string baseline; /*< File of 'NAME MEDIAN_NS' lines, empty means no comparison. */
+        double tolerance = 0.5; /*< Allowed slowdown against the baseline, 0.5 means 50%. */
+        bool updateBaseline = false; /*< Store every median, not only the missing ones. */
+        size_t jobs = 0; /*< Threads of the parallel tests, 0 means one per core. */
+        size_t slowest = 5; /*< Number of tests in the report of the slowest ones. */
+        size_t shardIndex = 0; /*< Run only the tests whose index modulo 'shardCount' is 'shardIndex'. */
+        size_t shardCount = 1;
+        bool isolate = false; /*< Run every test in a forked process, a crash fails only that test. */
+        double timeout = 0; /*< Seconds of an isolated test before it is killed, 0 means no limit. */
     } param;
 
 private:
+    /*! \brief Output and check counters of a test, only the thread running it writes them */
+    struct Record {
+        TestInstanceFunc func;
+        Mode mode;
+        size_t index; /*< Index among all the collected tests. */
+        Return ret;
+        std::string name;
+        double seconds;
+        size_t checksPass;
+        size_t checksFail;
+        std::stringstream result;
+    };
+
+    void runRecord(Record&);
+    void runIsolated(Record&);
+    std::ostream& out();
+    void label(const std::string& file, const std::string& func, const std::string& line);
     void test(const std::string& file, const std::string& func, const std::string& line);
+    void loadBaseline();
+    void storeBaseline();
 
     struct {
         size_t pass;
@@ -61,15 +100,17 @@ private:
         const size_t sum() const { return pass + fail; }
     } _checks = { 0, 0 };
     const bool _showPass;
-    std::set<TestInstanceFunc> _tests;
+    std::map<TestInstanceFunc, Mode> _tests;
     std::stringstream _result;
+    std::mutex _benchMutex;
+    std::mutex _forkMutex; /*< A forked child inherits no write end of the pipe of another test. */
+    bool _baselineLoaded = false;
+    std::map<std::string, double> _baseline;
+    std::map<std::string, double> _medians;
 };
 
-// Api tests.
-void apiTests(TestContext*);
-
-// Manual tests.
-void manualTests(TestContext* ctx);
+// Performance tests.
+void performanceTests(TestContext*);
 
 // Unit tests.
 void unitAndBehaviorTests(TestContext*);
@@ -0,0 +1,159 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+#include <vector>
+
+namespace testargparse {
+namespace {
+
+thread_local int t_calls;
+thread_local int t_argc;
+thread_local std::string t_program;
+thread_local std::string t_message;
+thread_local bool t_help;
+
+int commitCommand(int argc, char* argv[])
+{
+    ++t_calls;
+    t_argc = argc;
+    t_program = argv[0];
+    t_help = PARSE_HELP("-h, --help", "", "", argc, argv);
+    t_message = PARSE_FLAG("-m, --message MSG", std::string(), "");
+    std::string page;
+    ap::take_help_page(page);
+    return 7;
+}
+
+int cloneCommand(int, char*[])
+{
+    ++t_calls;
+    return 8;
+}
+
+TestContext::Return testRunCommand(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("-v"), TAP_CHARS("commit"), TAP_CHARS("-m"), TAP_CHARS("text") };
+    t_calls = 0;
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("clone", cloneCommand, "");
+    ADD_COMMAND("commit", commitCommand, "");
+    const bool verbose = PARSE_FLAG("-v, --verbose", false, "");
+    const std::string message = PARSE_FLAG("-m MSG", std::string("none"), "");
+    const size_t unparsed = UNPARSED_COUNT();
+    const int result = RUN_COMMAND(-1);
+
+    if (TAP_CHECK(ctx, !verbose))
+        return TAP_FAIL(ctx, "The flag before the subcommand is not parsed.");
+    if (TAP_CHECK(ctx, message != "none" || unparsed))
+        return TAP_FAIL(ctx, "The arguments after the subcommand have to be left for it.");
+    if (TAP_CHECK(ctx, result != 7 || t_calls != 1))
+        return TAP_FAIL(ctx, "The handler of the subcommand has to be called once.");
+    if (TAP_CHECK(ctx, t_argc != 3 || t_program != "commit" || t_message != "text"))
+        return TAP_FAIL(ctx, "The handler has to get argv from the name of the subcommand.");
+
+    return TAP_PASS(ctx, "Run the subcommand named in argv.");
+}
+
+TestContext::Return testMissingCommand(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("status") };
+    t_calls = 0;
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("clone", cloneCommand, "");
+    ADD_COMMAND("commit", commitCommand, "");
+    const int result = RUN_COMMAND(-1);
+
+    if (TAP_CHECK(ctx, result != -1 || t_calls))
+        return TAP_FAIL(ctx, "No handler has to be called without a subcommand.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT() != 1 || PARSE_ARG(std::string()) != "status"))
+        return TAP_FAIL(ctx, "An unknown subcommand has to be an argument of the program.");
+
+    return TAP_PASS(ctx, "Return the default without a subcommand.");
+}
+
+TestContext::Return testCommandsHelp(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--help"), TAP_CHARS("commit") };
+    t_calls = 0;
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("clone", cloneCommand, "clone a repository.");
+    ADD_COMMAND("commit", commitCommand, "record the changes.");
+    std::string page;
+    ap::take_help_page(page);
+    const int result = RUN_COMMAND(-1);
+
+    if (TAP_CHECK(ctx, page.find("clone") == std::string::npos || page.find("record the changes.") == std::string::npos))
+        return TAP_FAIL(ctx, "The help page has to list the subcommands.");
+    if (TAP_CHECK(ctx, result != -1 || t_calls))
+        return TAP_FAIL(ctx, "The help of the program must not call the handlers.");
+
+    return TAP_PASS(ctx, "List the subcommands in the help page.");
+}
+
+TestContext::Return testCommandHelp(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("commit"), TAP_CHARS("--help") };
+    t_calls = 0;
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("commit", commitCommand, "record the changes.");
+    const int result = RUN_COMMAND(-1);
+
+    if (TAP_CHECK(ctx, result != 7 || !t_help))
+        return TAP_FAIL(ctx, "The help after the subcommand belongs to the subcommand.");
+
+    return TAP_PASS(ctx, "Pass the help flag after the subcommand to it.");
+}
+
+TestContext::Return testManyCommands(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("command-77") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    std::vector<std::string> names;
+    for (int i = 0; i < 100; ++i)
+        names.push_back("command-" + std::to_string(i));
+    for (int i = 0; i < 100; ++i)
+        ADD_COMMAND(names[i], i == 77 ? cloneCommand : commitCommand, "");
+
+    if (TAP_CHECK(ctx, RUN_COMMAND(-1) != 8))
+        return TAP_FAIL(ctx, "Wrong handler of many subcommands.");
+
+    return TAP_PASS(ctx, "Find a subcommand of many.");
+}
+
+} // namespace anonymous
+
+void unitCommandsTests(TestContext* ctx)
+{
+    ctx->add(testRunCommand);
+    ctx->add(testMissingCommand);
+    ctx->add(testCommandsHelp);
+    ctx->add(testCommandHelp);
+    ctx->add(testManyCommands);
+}
+
+} // namespace testargparse
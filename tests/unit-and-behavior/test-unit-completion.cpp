@@ -0,0 +1,162 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+#include <vector>
+
+namespace testargparse {
+namespace {
+
+/* The queries are answered with ap::take_help_page(), FLUSH_HELP() would exit. */
+
+thread_local std::string t_page;
+
+int stashCommand(int argc, char* argv[])
+{
+    PARSE_HELP("-h, --help", "", "", argc, argv);
+    PARSE_FLAG("-k, --keep", false, "");
+    PARSE_FLAG("-p, --patch", false, "");
+    t_page.clear();
+    ap::take_help_page(t_page);
+    return 1;
+}
+
+/*! \brief Answer the query of 'words' at 'cword' with the options of a small program */
+std::string complete(const std::vector<std::string>& words, int cword, int* mode = nullptr)
+{
+    const std::string index = std::to_string(cword);
+    std::vector<const char*> argv = { "prog", "--ap-complete", index.c_str(), "--" };
+    for (size_t i = 0; i < words.size(); ++i)
+        argv.push_back(words[i].c_str());
+    PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+    ADD_COMMAND("status", stashCommand, "");
+    ADD_COMMAND("stash", stashCommand, "");
+    PARSE_FLAG("-v, --verbose", false, "");
+    const std::string value = PARSE_FLAG("-m, --mode MODE", std::string("fast"), "");
+    ADD_CHOICES("-m, --mode", "fast, full, slow");
+    const int size = PARSE_FLAG("--mem SIZE", 7, "");
+    if (mode)
+        *mode = value == "fast" && size == 7;
+    std::string page;
+    ap::take_help_page(page);
+    return page;
+}
+
+TestContext::Return testCompleteFlags(TestContext* ctx)
+{
+    int defaults = 0;
+
+    if (TAP_CHECK(ctx, complete({ "prog", "--m" }, 1, &defaults) != "--mem\n--mode\n"))
+        return TAP_FAIL(ctx, "The flags starting with the completed word have to be offered sorted.");
+    if (TAP_CHECK(ctx, !ap::s_complete || !ap::s_help || !defaults))
+        return TAP_FAIL(ctx, "A completion query has to be answered in help mode without parsing.");
+    if (TAP_CHECK(ctx, complete({ "prog", "-v", "--mode", "full", "-" }, 4) != "--help\n--mem\n--mode\n--verbose\n-h\n-m\n-v\n"))
+        return TAP_FAIL(ctx, "Every alias has to be offered after a prefix.");
+    if (TAP_CHECK(ctx, complete({ "prog", "--verbose", "st" }, 2) != "stash\nstatus\n"))
+        return TAP_FAIL(ctx, "The subcommands have to be offered for a word without prefix.");
+    if (TAP_CHECK(ctx, complete({ "prog", "--x" }, 1) != ""))
+        return TAP_FAIL(ctx, "Nothing has to be offered for an unknown flag.");
+
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--mode") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    if (TAP_CHECK(ctx, ap::s_complete || ap::s_help))
+        return TAP_FAIL(ctx, "The next parse has to leave the completion mode.");
+
+    return TAP_PASS(ctx, "Complete the flags and the subcommands.");
+}
+
+TestContext::Return testCompleteValues(TestContext* ctx)
+{
+    if (TAP_CHECK(ctx, complete({ "prog", "--mode", "" }, 2) != "fast\nfull\nslow\n"))
+        return TAP_FAIL(ctx, "The choices of the flag before the completed word have to be offered.");
+    if (TAP_CHECK(ctx, complete({ "prog", "-m", "f", "-v" }, 2) != "fast\nfull\n"))
+        return TAP_FAIL(ctx, "The choices have to start with the completed word.");
+    if (TAP_CHECK(ctx, complete({ "prog", "--mode=s" }, 1) != "--mode=slow\n"))
+        return TAP_FAIL(ctx, "The choices after the delimiter have to keep the flag.");
+    if (TAP_CHECK(ctx, complete({ "prog", "--mode", "=", "f" }, 3) != "fast\nfull\n" || complete({ "prog", "--mode", "=" }, 2) != "fast\nfull\nslow\n"))
+        return TAP_FAIL(ctx, "The delimiter split by bash has to be handled.");
+    if (TAP_CHECK(ctx, complete({ "prog", "--mem", "" }, 2) != "" || complete({ "prog", "--mem", "-" }, 2) != ""))
+        return TAP_FAIL(ctx, "Nothing has to be offered for a value without choices.");
+    if (TAP_CHECK(ctx, complete({ "prog", "-v", "--me" }, 2) != "--mem\n"))
+        return TAP_FAIL(ctx, "A flag without value must not take the completed word.");
+
+    return TAP_PASS(ctx, "Complete the values of a flag.");
+}
+
+TestContext::Return testCompleteCommand(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--ap-complete"), TAP_CHARS("3"), TAP_CHARS("--"), TAP_CHARS("prog"), TAP_CHARS("-v"), TAP_CHARS("stash"), TAP_CHARS("--p") };
+    t_page = "none";
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("stash", stashCommand, "");
+    PARSE_FLAG("-v, --verbose", false, "");
+    PARSE_FLAG("--pager", false, "");
+    const int result = ap::find_command() ? ap::run_command() : -1;
+
+    if (TAP_CHECK(ctx, result != 1 || t_page != "--patch\n"))
+        return TAP_FAIL(ctx, "The handler of the subcommand has to answer the query of its words.");
+
+    return TAP_PASS(ctx, "Complete the flags of a subcommand.");
+}
+
+TestContext::Return testCompletionScripts(TestContext* ctx)
+{
+    const std::string bash = ap::completion_script("bash", "/usr/bin/my-tool");
+    const std::string zsh = ap::completion_script("zsh", "my-tool");
+    const std::string fish = ap::completion_script("fish", "my-tool");
+
+    if (TAP_CHECK(ctx, bash.find("complete -o default -F _ap_complete_my_tool my-tool\n") == std::string::npos || bash.find("--ap-complete") == std::string::npos))
+        return TAP_FAIL(ctx, "Wrong bash script.");
+    if (TAP_CHECK(ctx, zsh.find("#compdef my-tool\n") || zsh.find("compdef _ap_complete_my_tool my-tool\n") == std::string::npos))
+        return TAP_FAIL(ctx, "Wrong zsh script.");
+    if (TAP_CHECK(ctx, fish.find("complete -c my-tool -a '(_ap_complete_my_tool)'\n") == std::string::npos))
+        return TAP_FAIL(ctx, "Wrong fish script.");
+    if (TAP_CHECK(ctx, !ap::completion_script("tcsh", "my-tool").empty()))
+        return TAP_FAIL(ctx, "An unknown shell has no script.");
+
+    char* argv[] = { TAP_CHARS("my-tool"), TAP_CHARS("--ap-completion"), TAP_CHARS("fish") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-v, --verbose", false, "");
+    std::string page;
+    ap::take_help_page(page);
+    if (TAP_CHECK(ctx, page != fish))
+        return TAP_FAIL(ctx, "The script has to be the answer of '--ap-completion'.");
+
+    return TAP_PASS(ctx, "Generate the completion scripts.");
+}
+
+} // namespace anonymous
+
+void unitCompletionTests(TestContext* ctx)
+{
+    ctx->add(testCompleteFlags);
+    ctx->add(testCompleteValues);
+    ctx->add(testCompleteCommand);
+    ctx->add(testCompletionScripts);
+}
+
+} // namespace testargparse
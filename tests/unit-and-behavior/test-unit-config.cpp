@@ -0,0 +1,176 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.hpp"
+
+#include "arg-parser-config.h"
+#include "test-defs.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace testargparse {
+namespace {
+
+#define CONFIG_OPTIONS(OPTION) \
+    OPTION(size, int, 300, "-s, --size SIZE", "set size.") \
+    OPTION(enable, bool, false, "-e, --enable", "enable something.") \
+    OPTION(name, std::string, "none", "-n, --name NAME", "set name.")
+AP_OPTIONS(ConfigOptions, CONFIG_OPTIONS);
+
+/*! \brief A config file in a directory of its own, removed with the directory at the end */
+struct ConfigFile {
+    ConfigFile()
+    {
+        char pattern[] = "/tmp/ap-config-XXXXXX";
+        directory = mkdtemp(pattern) ? pattern : "/tmp";
+        path = directory + "/test.conf";
+    }
+    ~ConfigFile()
+    {
+        std::remove((path + ".new").c_str());
+        std::remove(path.c_str());
+        rmdir(directory.c_str());
+    }
+
+    /*! \brief Replace the file like an editor does, by renaming a new one over it */
+    void write(const std::string& text) const
+    {
+        const std::string temporary = path + ".new";
+        if (std::FILE* file = std::fopen(temporary.c_str(), "wb")) {
+            std::fwrite(text.data(), 1, text.size(), file);
+            std::fclose(file);
+        }
+        std::rename(temporary.c_str(), path.c_str());
+    }
+
+    std::string directory;
+    std::string path;
+};
+
+TestContext::Return testConfigReload(TestContext* ctx)
+{
+    const ConfigFile file;
+    // The versions are checked, so the files are reloaded only by the test.
+    ap::Config<ConfigOptions> missing(file.path, false);
+    if (TAP_CHECK(ctx, missing.version() != 1 || missing.read()->options.size != 300 || missing.reload()))
+        return TAP_FAIL(ctx, "A missing file has to give the defaults.");
+
+    file.write("--size 4 # the size\n-e --name 'two words'\n");
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--size"), TAP_CHARS("7") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ap::Config<ConfigOptions> config(file.path, false);
+    {
+        const ap::Config<ConfigOptions>::Reader options = config.read();
+        if (TAP_CHECK(ctx, options->version != 1 || options->options.size != 4 || !options->options.enable || options->options.name != "two words" || options->unparsed))
+            return TAP_FAIL(ctx, "Wrong options of the config file.");
+    }
+    if (TAP_CHECK(ctx, PARSE_FLAG("-s, --size SIZE", 0, "") != 7))
+        return TAP_FAIL(ctx, "The config has to keep the parse of argv.");
+
+    file.write("--size 5 -e --name 'two words' extra\n");
+    config.reload();
+    if (TAP_CHECK(ctx, config.version() != 2 || config.read()->options.size != 5 || config.read()->unparsed != 1))
+        return TAP_FAIL(ctx, "The changed file has to be published.");
+    if (TAP_CHECK(ctx, !config.changed_since(ConfigOptions::size_index, 1) || config.changed_since(ConfigOptions::enable_index, 1) || config.changed_since(ConfigOptions::size_index, 2)))
+        return TAP_FAIL(ctx, "Wrong versions of the options.");
+    if (TAP_CHECK(ctx, config.reload() || config.version() != 2 || config.watching()))
+        return TAP_FAIL(ctx, "A file changing no option must not be published.");
+
+    return TAP_PASS(ctx, "Reload a config file.");
+}
+
+TestContext::Return testConfigReaders(TestContext* ctx)
+{
+    const ConfigFile file;
+    file.write("--size 1 --name n1");
+    ap::Config<ConfigOptions> config(file.path, false);
+    {
+        const ap::Config<ConfigOptions>::Reader pinned = config.read();
+        file.write("--size 2 --name n2");
+        config.reload();
+        if (TAP_CHECK(ctx, config.pending() != 1 || pinned->options.name != "n1" || config.read()->options.name != "n2"))
+            return TAP_FAIL(ctx, "A pinned snapshot has to be kept until its reader is done.");
+    }
+    file.write("--size 3 --name n3");
+    config.reload();
+    if (TAP_CHECK(ctx, config.pending()))
+        return TAP_FAIL(ctx, "The snapshots without readers have to be freed.");
+
+    // The readers check that every snapshot they see is whole while it is replaced.
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+    std::thread readers[2];
+    for (std::thread& reader : readers)
+        reader = std::thread([&]() {
+            while (!done) {
+                const ap::Config<ConfigOptions>::Reader options = config.read();
+                torn += options->options.name != "n" + std::to_string(options->options.size);
+                std::this_thread::yield();
+            }
+        });
+    for (int size = 4; size < 24; ++size) {
+        file.write("--size " + std::to_string(size) + " --name n" + std::to_string(size));
+        config.reload();
+    }
+    done = true;
+    for (std::thread& reader : readers)
+        reader.join();
+    if (TAP_CHECK(ctx, torn))
+        return TAP_FAIL(ctx, "A reader has seen a torn snapshot.");
+
+    return TAP_PASS(ctx, "Read the snapshots while they are replaced.");
+}
+
+TestContext::Return testConfigWatch(TestContext* ctx)
+{
+    const ConfigFile file;
+    file.write("--size 1");
+    ap::Config<ConfigOptions> config(file.path);
+    if (!config.watching())
+        return TAP_NOT_TESTED(ctx, "The file is not watched on this system.");
+
+    file.write("--size 2");
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    while (config.version() == 1 && std::chrono::steady_clock::now() - begin < std::chrono::seconds(5))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (TAP_CHECK(ctx, config.version() != 2 || config.read()->options.size != 2))
+        return TAP_FAIL(ctx, "The changed file has to be reloaded in the background.");
+
+    return TAP_PASS(ctx, "Watch a config file.");
+}
+
+} // namespace anonymous
+
+void unitConfigTests(TestContext* ctx)
+{
+    ctx->add(testConfigReload);
+    ctx->add(testConfigReaders);
+    ctx->add(testConfigWatch);
+}
+
+} // namespace testargparse
@@ -0,0 +1,142 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "test.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+
+namespace testargparse {
+namespace {
+
+static_assert(ap::spec::is_valid("-s, --size SIZE", false), "Spec with a value name.");
+static_assert(ap::spec::is_valid("  -e ,  --enable", true), "Spec with spaces around the commas.");
+static_assert(ap::spec::is_valid("+x", true), "Spec with a '+' prefix.");
+static_assert(!ap::spec::is_valid("", false), "Empty spec.");
+static_assert(!ap::spec::is_valid("size", false), "Alias without prefix.");
+static_assert(!ap::spec::is_valid("-s, --", false), "Alias of prefixes only.");
+static_assert(!ap::spec::is_valid("-s,", false), "Missing alias after the comma.");
+static_assert(!ap::spec::is_valid("-e VALUE", true), "Value name of a bool flag.");
+
+constexpr const char* s_uniqueSpecs[] = { "-a, --aa N", "-aa, --a", "-b N", nullptr };
+static_assert(ap::spec::is_unique(s_uniqueSpecs, 0, 3), "Prefix of an alias is a different alias.");
+static_assert(ap::spec::is_unique(s_uniqueSpecs, 1, 3), "Prefix of an alias is a different alias.");
+constexpr const char* s_duplicatedSpecs[] = { "-a, -b", "-c N", "-d, -b N", "-e, -e", nullptr };
+static_assert(!ap::spec::is_unique(s_duplicatedSpecs, 0, 4), "Alias in a later spec.");
+static_assert(ap::spec::is_unique(s_duplicatedSpecs, 1, 4), "Value name is not an alias.");
+static_assert(!ap::spec::is_unique(s_duplicatedSpecs, 3, 4), "Alias twice in a spec.");
+
+#define TEST_OPTIONS(OPTION) \
+    OPTION(size, int, 300, "-s, --size SIZE", "set size. Default is '%d'.") \
+    OPTION(enable, bool, false, "-e, --enable", "enable something.") \
+    OPTION(name, std::string, "none", "-n, --name NAME", "set name.") \
+    OPTION(ratio, float, 0.5f, "-r, --ratio RATIO", "set ratio.")
+AP_OPTIONS(TestOptions, TEST_OPTIONS);
+
+TestContext::Return testDeclaredOptions(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--name"), TAP_CHARS("joe"), TAP_CHARS("-e"), TAP_CHARS("-s"), TAP_CHARS("42") };
+    PARSE_HELP("--help", "", "", TAP_ARRAY_SIZE(argv), argv);
+
+    TestOptions options;
+    PARSE_OPTIONS(options);
+
+    if (TAP_CHECK(ctx, options.size != 42))
+        return TAP_FAIL(ctx, "Wrong size: " + std::to_string(options.size) + ".");
+    if (TAP_CHECK(ctx, !options.enable))
+        return TAP_FAIL(ctx, "Flag is not enabled.");
+    if (TAP_CHECK(ctx, options.name != "joe"))
+        return TAP_FAIL(ctx, "Wrong name: '" + options.name + "'.");
+    if (TAP_CHECK(ctx, options.ratio != 0.5f))
+        return TAP_FAIL(ctx, "Default is changed.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "Not every option is consumed.");
+
+    return TAP_PASS(ctx, "Parse a struct declared with AP_OPTIONS.");
+}
+
+TestContext::Return testDeclaredTables(TestContext* ctx)
+{
+    const ap::OptionSpec* specs = TestOptions::specs();
+    const char* strings = TestOptions::strings();
+
+    if (TAP_CHECK(ctx, specs[TestOptions::name_index].flags(strings).str() != "-n, --name NAME"))
+        return TAP_FAIL(ctx, "Wrong flags: '" + specs[TestOptions::name_index].flags(strings).str() + "'.");
+    if (TAP_CHECK(ctx, specs[TestOptions::enable_index].msg(strings).str() != "enable something."))
+        return TAP_FAIL(ctx, "Wrong help: '" + specs[TestOptions::enable_index].msg(strings).str() + "'.");
+    if (TAP_CHECK(ctx, specs[TestOptions::OptionCount].flagsSize != 0))
+        return TAP_FAIL(ctx, "Missing sentinel of the spec table.");
+
+    return TAP_PASS(ctx, "Specs and helps are in the string table.");
+}
+
+#define CODEC_OPTIONS(OPTION) \
+    OPTION(rate, int, 44100, "--codec-rate RATE", "set the sample rate. Default is '%d'.") \
+    OPTION(mono, bool, false, "--codec-mono", "mix the channels.")
+AP_OPTIONS(CodecOptions, CODEC_OPTIONS);
+
+thread_local int t_groupParses;
+
+void parseCodec(void* context)
+{
+    ++t_groupParses;
+    PARSE_OPTIONS(*static_cast<CodecOptions*>(context));
+}
+
+TestContext::Return testOptionGroups(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--codec-mono"), TAP_CHARS("file") };
+    PARSE_HELP("--help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    TestOptions options;
+    CodecOptions codec;
+    if (TAP_CHECK(ctx, PARSE_OPTION_GROUP(options) || options.size != 300))
+        return TAP_FAIL(ctx, "A group without its flags in argv must not be parsed.");
+    if (TAP_CHECK(ctx, !PARSE_OPTION_GROUP(codec) || !codec.mono || UNPARSED_COUNT() != 1))
+        return TAP_FAIL(ctx, "A group with a flag in argv has to be parsed.");
+
+    t_groupParses = 0;
+    char* helpArgv[] = { TAP_CHARS("prog"), TAP_CHARS("--help") };
+    PARSE_HELP("--help", "", "", TAP_ARRAY_SIZE(helpArgv), helpArgv);
+    const ap::OptionGroup group = { CodecOptions::specs(), CodecOptions::strings(), parseCodec, &codec };
+    std::string page;
+    if (TAP_CHECK(ctx, !ap::add_option_group(group) || t_groupParses != 1 || !ap::take_help_page(page)))
+        return TAP_FAIL(ctx, "Every group has to be parsed for the help.");
+    if (TAP_CHECK(ctx, page.find("--codec-rate RATE") == std::string::npos))
+        return TAP_FAIL(ctx, "The options of the group are missing from the help.");
+
+    return TAP_PASS(ctx, "Parse the option groups only if they are needed.");
+}
+
+} // namespace anonymous
+
+void unitDeclaredOptionsTests(TestContext* ctx)
+{
+    ctx->add(testDeclaredOptions);
+    ctx->add(testDeclaredTables);
+    ctx->add(testOptionGroups);
+}
+
+} // namespace testargparse
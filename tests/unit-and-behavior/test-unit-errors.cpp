@@ -22,166 +22,242 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "test-unit.hpp"
+#include "test.hpp"
 
-#include "arg-parse.hpp"
-#include <assert.h>
-#include <iostream> // only for testing, delete it!
+#include "alloc-counter.h"
+#include "arg-parser.h"
+#include "test-defs.hpp"
+#include <climits>
+#include <limits>
+#include <string>
+#include <vector>
 
 namespace testargparse {
 namespace {
 
-using namespace argparse;
-
-TestContext::Return testArgArgvIsNullPtr(TestContext* ctx)
+/*! \brief Return true if the error 'i' of the parse is 'code' at 'token' of the definition 'spec' */
+bool isError(size_t i, ap::ErrorCode code, size_t token, size_t spec)
 {
-    ArgParse ap;
-    const bool parseRet = ap.parse(1985, nullptr);
-
-    TAP_CHECK_PARSER_EXPECTED_RETURN(ctx, (parseRet == true));
-
-    if (!ap.errors.data.size())
-        return TAP_FAIL(ctx, "Missing error logging after 'argv' is 'nullptr'!");
-
-    if (ap.errors.data[0].code != ArgParse::Errors::Codes::Parse_ArgVIsEmpty)
-        return TAP_FAIL(ctx, "The 'argv' is 'nullptr', but error codes is wrong!");
-
-    if (ap.errors.data[0].suspect.type != ArgParse::Errors::Error::Suspect::GeneralType)
-        return TAP_FAIL(ctx, "Wrong error type!");
-
-    return TAP_PASS(ctx, "ArgCount test with 'argv' is nullptr.");
+    const ap::Error& error = ap::error_at(i);
+    return error.code == code && error.token == token && error.spec == spec;
 }
 
-TestContext::Return testArgCountEmptyArgv(TestContext* ctx)
+bool endsWith(const std::string& text, const std::string& end)
 {
-    char* argv[] = { nullptr };
-    const int argc = 2;
-
-    ArgParse ap;
-    const bool parseRet = ap.parse(argc, argv);
-
-    TAP_CHECK_PARSER_EXPECTED_RETURN(ctx, (parseRet == true));
-
-    if (!ap.errors.data.size())
-        return TAP_FAIL(ctx, "Missing error logging after 'argc' is '0'!");
-
-    if (ap.errors.data[0].code != ArgParse::Errors::Codes::Parse_ArgVIsEmpty)
-        return TAP_FAIL(ctx, "The 'argv' is empty, but error codes is wrong!");
-
-    if (ap.errors.data[0].suspect.type != ArgParse::Errors::Error::Suspect::GeneralType)
-        return TAP_FAIL(ctx, "Wrong error type!");
-
-    return TAP_PASS(ctx, "ArgCount test with empty 'argv'.");
+    return text.size() >= end.size() && !text.compare(text.size() - end.size(), end.size(), end);
 }
 
-TestContext::Return testArgCountZeroArgc(TestContext* ctx)
+TestContext::Return testArgvIsEmpty(TestContext* ctx)
 {
-    char* argv[] = { TAP_CHARS("program") };
-    const int argc = 0;
-
-    ArgParse ap;
-    const bool parseRet = ap.parse(argc, argv);
-
-    TAP_CHECK_PARSER_EXPECTED_RETURN(ctx, (parseRet == true));
+    PARSE_HELP("-h, --help", "", "", 1985, static_cast<char**>(nullptr));
+    if (TAP_CHECK(ctx, ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::ArgvIsEmpty, 0, 0) || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "The 'argv' is 'nullptr', but the error is wrong.");
 
-    if (!ap.errors.data.size())
-        return TAP_FAIL(ctx, "Missing error logging after 'argc' is '0'!");
+    char* empty[] = { nullptr };
+    PARSE_HELP("-h, --help", "", "", 2, empty);
+    if (TAP_CHECK(ctx, ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::ArgvIsEmpty, 0, 0)))
+        return TAP_FAIL(ctx, "The 'argv' is empty, but the error is wrong.");
 
-    if (ap.errors.data[0].code != ArgParse::Errors::Codes::Parse_ArgVIsEmpty)
-        return TAP_FAIL(ctx, "The 'argv' is empty, but error codes is wrong!");
+    char* argv[] = { TAP_CHARS("program") };
+    PARSE_HELP("-h, --help", "", "", 0, argv);
+    if (TAP_CHECK(ctx, ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::ArgvIsEmpty, 0, 0) || FORMAT_ERRORS() != "argv is empty\n"))
+        return TAP_FAIL(ctx, "The 'argc' is '0', but the error is wrong.");
 
-    if (ap.errors.data[0].suspect.type != ArgParse::Errors::Error::Suspect::GeneralType)
-        return TAP_FAIL(ctx, "Wrong error type!");
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    if (TAP_CHECK(ctx, FINISH_PARSE() || FORMAT_ERRORS() != ""))
+        return TAP_FAIL(ctx, "A non empty 'argv' has no error.");
 
-    return TAP_PASS(ctx, "ArgCount test with zero 'argc'.");
+    return TAP_PASS(ctx, "Check an empty 'argv'.");
 }
 
-TestContext::Return testArgcBiggerSizeOfArgv(TestContext* ctx)
+TestContext::Return testArgcExceedsArgv(TestContext* ctx)
 {
-    char* argv[] = { TAP_CHARS("program") };
-    const int argc = 1985;
-
-    ArgParse ap;
-    const bool parseRet = ap.parse(argc, argv);
-
-    TAP_CHECK_PARSER_EXPECTED_RETURN(ctx, (parseRet == true));
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("-v"), nullptr };
+    PARSE_HELP("-h, --help", "", "", 1985, argv);
+    const bool verbose = PARSE_FLAG("-v, --verbose", false, "");
 
-    if (!ap.errors.data.size())
-        return TAP_FAIL(ctx, "Missing error logging after 'argc' is '0'!");
+    if (TAP_CHECK(ctx, ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::ArgcExceedsArgv, 0, 0)))
+        return TAP_FAIL(ctx, "The 'argc' is bigger than the elements of 'argv', but the error is wrong.");
+    if (TAP_CHECK(ctx, !verbose || FINISH_PARSE() != 1))
+        return TAP_FAIL(ctx, "The arguments before the 'nullptr' have to be parsed.");
 
-    if (ap.errors.data[0].code != ArgParse::Errors::Codes::Parse_ArgCBiggerThanElementsOfArgV)
-        return TAP_FAIL(ctx, std::string("Wrong error code! The code is: ") + std::to_string(ap.errors.data[0].code));
-
-    if (ap.errors.data[0].suspect.type != ArgParse::Errors::Error::Suspect::GeneralType)
-        return TAP_FAIL(ctx, "Wrong error type!");
-
-    return TAP_PASS(ctx, "ArgCount test with zero 'argc'.");
+    return TAP_PASS(ctx, "Check an 'argc' bigger than the elements of 'argv'.");
 }
 
-TestContext::Return testArgCountNonEmptyArgv(TestContext* ctx)
+TestContext::Return testValueErrors(TestContext* ctx)
 {
-    char* argv[] = { TAP_CHARS("program") };
-    const int argc = TAP_ARRAY_SIZE(argv);
-
-    ArgParse ap;
-    const bool parseRet = ap.parse(argc, argv);
-
-    TAP_CHECK_PARSER_EXPECTED_RETURN(ctx, (parseRet != true));
-
-    TAP_CHECK_NON_REQUIRED_ERRORS(ctx, ap, 0);
-
-    return TAP_PASS(ctx, "ArgCount test with non empty 'argv'.");
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("--size"), TAP_CHARS("4x"), TAP_CHARS("--count=99999999999"), TAP_CHARS("-u"), TAP_CHARS("-1"), TAP_CHARS("-r"), TAP_CHARS("1e999"), TAP_CHARS("-d"), TAP_CHARS(" 0.5 "), TAP_CHARS("-n"), TAP_CHARS("-1e999"), TAP_CHARS("x") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    const int size = PARSE_FLAG("-s, --size SIZE", 300, "");
+    const int count = PARSE_FLAG("-c, --count COUNT", 0, "");
+    const unsigned unsignedValue = PARSE_FLAG("-u, --unsigned VALUE", 7u, "");
+    const float ratio = PARSE_FLAG("-r, --ratio RATIO", 0.5f, "");
+    const double delta = PARSE_FLAG("-d, --delta DELTA", 1.0, "");
+    const double negative = PARSE_FLAG("-n, --negative NEGATIVE", 0.0, "");
+    const int arg = PARSE_ARG(42);
+
+    if (TAP_CHECK(ctx, size != 300 || count != INT_MAX || unsignedValue || delta != 0.5 || arg != 42))
+        return TAP_FAIL(ctx, "An invalid value has to keep the default, and a value out of range has to be clamped.");
+    if (TAP_CHECK(ctx, ratio != std::numeric_limits<float>::max() || negative != -std::numeric_limits<double>::max()))
+        return TAP_FAIL(ctx, "A floating point value out of range has to be clamped to the largest finite value.");
+    if (TAP_CHECK(ctx, ERROR_COUNT() != 6))
+        return TAP_FAIL(ctx, "Wrong number of errors: " + std::to_string(ERROR_COUNT()) + ".");
+    if (TAP_CHECK(ctx, !isError(0, ap::ErrorCode::InvalidValue, 2, 1) || !isError(1, ap::ErrorCode::ValueOutOfRange, 4, 2) || !isError(2, ap::ErrorCode::ValueOutOfRange, 6, 3) || !isError(3, ap::ErrorCode::ValueOutOfRange, 8, 4) || !isError(4, ap::ErrorCode::ValueOutOfRange, 12, 6) || !isError(5, ap::ErrorCode::InvalidValue, 13, 7)))
+        return TAP_FAIL(ctx, "Wrong errors of the values.");
+    if (TAP_CHECK(ctx, ap::error_at(0).flags.str() != "-s, --size SIZE" || ap::error_at(5).flags.size))
+        return TAP_FAIL(ctx, "The errors have to refer to the spec of their flags.");
+
+    const std::string text = FORMAT_ERRORS();
+    if (TAP_CHECK(ctx, text.find("invalid value '4x' of '-s, --size SIZE'\nvalue out of range '99999999999' of '-c, --count COUNT'\n") || !endsWith(text, "'1e999' of '-r, --ratio RATIO'\nvalue out of range '-1e999' of '-n, --negative NEGATIVE'\ninvalid value 'x'\n")))
+        return TAP_FAIL(ctx, "Wrong text of the errors:\n" + text);
+
+    return TAP_PASS(ctx, "Report the values which are not of their types.");
 }
 
-TestContext::Return testErrorCode(TestContext* ctx)
+TestContext::Return testMissingValue(TestContext* ctx)
 {
-    char* argv[] = { TAP_CHARS("program") };
-    const int argc = TAP_ARRAY_SIZE(argv);
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("-v"), TAP_CHARS("--size") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-v, --verbose", false, "");
+    const int size = PARSE_FLAG("-s, --size SIZE", 300, "");
 
-    ArgParse ap;
+    if (TAP_CHECK(ctx, size != 300 || ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::MissingValue, 2, 2)))
+        return TAP_FAIL(ctx, "A flag without its value has to be reported.");
+    if (TAP_CHECK(ctx, FINISH_PARSE() != 1 || FORMAT_ERRORS() != "missing value of '--size'\n"))
+        return TAP_FAIL(ctx, "Wrong errors:\n" + FORMAT_ERRORS());
 
-    ap.def(Arg("arg1", "this arg needed", Arg::Required));
-    ap.def(Arg("arg2", "this arg needed", Arg::Required));
-    ap.def(Arg("arg3", "this arg not needed", !Arg::Required));
+    return TAP_PASS(ctx, "Report a flag without its value.");
+}
 
-    const bool parseRet = ap.parse(argc, argv);
+TestContext::Return testFinishParse(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("file"), TAP_CHARS("--sizr=4"), TAP_CHARS("-5"), TAP_CHARS("--size"), TAP_CHARS("4"), TAP_CHARS("-x") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-s, --size SIZE", 300, "");
+    PARSE_ARG(std::string());
+
+    if (TAP_CHECK(ctx, ERROR_COUNT() || FINISH_PARSE() != 3))
+        return TAP_FAIL(ctx, "The unparsed arguments have to be reported when the parse is finished.");
+    if (TAP_CHECK(ctx, !isError(0, ap::ErrorCode::UnknownFlag, 2, 0) || !isError(1, ap::ErrorCode::UnexpectedArgument, 4, 0) || !isError(2, ap::ErrorCode::UnknownFlag, 7, 0)))
+        return TAP_FAIL(ctx, "Wrong errors:\n" + FORMAT_ERRORS());
+    if (TAP_CHECK(ctx, FORMAT_ERRORS() != "unknown flag '--sizr', did you mean '--size'?\nunexpected argument '-5'\nunknown flag '-x'\n"))
+        return TAP_FAIL(ctx, "Wrong text of the errors:\n" + FORMAT_ERRORS());
+
+    char* help[] = { TAP_CHARS("program"), TAP_CHARS("--help"), TAP_CHARS("-a"), TAP_CHARS("3") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(help), help);
+    PARSE_FLAG("-a A", 0, "");
+    std::string page;
+    ap::take_help_page(page);
+    if (TAP_CHECK(ctx, FINISH_PARSE()))
+        return TAP_FAIL(ctx, "The arguments must not be reported in help mode:\n" + FORMAT_ERRORS());
+
+    return TAP_PASS(ctx, "Report the unparsed arguments.");
+}
 
-    if (parseRet == true)
-        return TAP_FAIL(ctx, "The parse() return true instead of false!");
+int statusCommand(int, char*[])
+{
+    return 0;
+}
 
-    if (!ap.errors.data.size())
-        return TAP_FAIL(ctx, "Missing error logging after some args missing!");
+TestContext::Return testSuggestions(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("--verbsoe"), TAP_CHARS("--mode"), TAP_CHARS("fsat"), TAP_CHARS("--hlep"), TAP_CHARS("stauts"), TAP_CHARS("--nothing-alike") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    ADD_COMMAND("status", statusCommand, "");
+    PARSE_FLAG("-v, --verbose", false, "");
+    const std::string mode = PARSE_FLAG("-m, --mode MODE", std::string("fast"), "");
+    ADD_CHOICES("-m, --mode", "fast, full, slow");
+
+    if (TAP_CHECK(ctx, mode != "fsat" || ERROR_COUNT() != 1 || !isError(0, ap::ErrorCode::InvalidChoice, 3, 2)))
+        return TAP_FAIL(ctx, "A value which is not one of the choices has to be reported and kept.");
+    if (TAP_CHECK(ctx, FINISH_PARSE() != 5 || ap::suggest(ap::error_at(1)).str() != "--verbose" || ap::suggest(ap::error_at(4)).size))
+        return TAP_FAIL(ctx, "Wrong suggestions:\n" + FORMAT_ERRORS());
+    const std::string expected = "invalid choice 'fsat' of '-m, --mode MODE', did you mean 'fast'?\n"
+                                 "unknown flag '--verbsoe', did you mean '--verbose'?\n"
+                                 "unknown flag '--hlep', did you mean '--help'?\n"
+                                 "unexpected argument 'stauts', did you mean 'status'?\n"
+                                 "unknown flag '--nothing-alike'\n";
+    if (TAP_CHECK(ctx, FORMAT_ERRORS() != expected))
+        return TAP_FAIL(ctx, "Wrong text of the suggestions:\n" + FORMAT_ERRORS());
+
+    // The prefixes of the flags are not compared.
+    char* prefixed[] = { TAP_CHARS("program"), TAP_CHARS("--zz"), TAP_CHARS("-verbose") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(prefixed), prefixed);
+    PARSE_FLAG("-a, --aa", false, "");
+    PARSE_FLAG("-v, --verbose", false, "");
+    if (TAP_CHECK(ctx, FINISH_PARSE() != 2 || ap::suggest(ap::error_at(0)).size || ap::suggest(ap::error_at(1)).str() != "--verbose"))
+        return TAP_FAIL(ctx, "Wrong suggestions of the short typos:\n" + FORMAT_ERRORS());
+
+    return TAP_PASS(ctx, "Suggest the closest flag, subcommand or choice.");
+}
 
-    TAP_CHECK_NON_REQUIRED_ERRORS(ctx, ap, 2);
+TestContext::Return testTemporarySpecs(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("program"), TAP_CHARS("--number-of-things"), TAP_CHARS("abc"), TAP_CHARS("--mode=fsat"), TAP_CHARS("--hepl"), TAP_CHARS("--late"), TAP_CHARS("x") };
+    const std::string prefix = "--";
+    PARSE_HELP(std::string("-h, ") + prefix + "help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG(prefix + "number-of-things N", 1, "");
+    PARSE_FLAG(prefix + "mode MODE", std::string(), "");
+    ADD_CHOICES(prefix + "mode", std::string("fast, slow"));
+    // The specs of a long list of flags do not fit the inline buffer of the parser.
+    for (int i = 0; i < 300; ++i)
+        PARSE_FLAG(prefix + "padding-flag-" + std::to_string(i) + " X", 0, "");
+    PARSE_FLAG(prefix + "late N", 1, "");
+    FINISH_PARSE();
+
+    const std::string text = FORMAT_ERRORS();
+    if (TAP_CHECK(ctx, text != "invalid value 'abc' of '--number-of-things N'\ninvalid choice 'fsat' of '--mode MODE', did you mean 'fast'?\n"
+                              "invalid value 'x' of '--late N'\nunknown flag '--hepl', did you mean '--help'?\n"))
+        return TAP_FAIL(ctx, "Wrong text of the errors:\n" + text);
+    if (TAP_CHECK(ctx, ap::error_at(2).flags.str() != "--late N"))
+        return TAP_FAIL(ctx, "The error has to refer to the copy of its spec.");
+
+    return TAP_PASS(ctx, "Keep the specs of temporary strings for the errors.");
+}
 
-    for (auto const& e : ap.errors.data) {
-        switch (e.code) {
-        case ArgParse::Errors::Codes::Parse_RequiredArgumentMissing:
-            assert(e.suspect.arg && "Argument missing!");
-            if (e.suspect.type != ArgParse::Errors::Error::Suspect::ArgType)
-                return TAP_FAIL(ctx, "Wrong error type!");
-            else if (!e.suspect.arg->Required)
-                return TAP_FAIL(ctx, "Wrong argument option!");
-            break;
-        default:
-            return TAP_FAIL(ctx, "Wrong ErrorCode!");
-            break;
-        }
+TestContext::Return testErrorCapacity(TestContext* ctx)
+{
+    std::vector<std::string> args(1, "program");
+    for (size_t i = 0; i < ap::ErrorCapacity + 4; ++i)
+        args.push_back("--unknown-" + std::to_string(i));
+    args.push_back("--size");
+    args.push_back("x");
+    std::vector<const char*> argv;
+    for (size_t i = 0; i < args.size(); ++i)
+        argv.push_back(args[i].c_str());
+
+    size_t allocs = 0;
+    for (int run = 0; run < 2; ++run) {
+        const apbench::AllocCounts begin = apbench::allocCounts();
+        PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+        PARSE_FLAG("-s, --size SIZE", 300, "");
+        FINISH_PARSE();
+        allocs = apbench::allocCountsSince(begin).allocs;
     }
 
-    return TAP_PASS(ctx, "ErrorCode tests");
+    if (TAP_CHECK(ctx, allocs))
+        return TAP_FAIL(ctx, "Recording the errors allocated " + std::to_string(allocs) + " times.");
+    if (TAP_CHECK(ctx, ERROR_COUNT() != ap::ErrorCapacity + 5 || !isError(0, ap::ErrorCode::InvalidValue, argv.size() - 1, 1)))
+        return TAP_FAIL(ctx, "Every error has to be counted.");
+    const std::string text = FORMAT_ERRORS();
+    if (TAP_CHECK(ctx, !endsWith(text, "unknown flag '--unknown-14'\nand 5 more errors\n")))
+        return TAP_FAIL(ctx, "The errors over the capacity have to be summed up:\n" + text);
+
+    return TAP_PASS(ctx, "Record the errors in a fixed buffer without allocations.");
 }
 
 } // namespace anonymous
 
 void unitErrorsTests(TestContext* ctx)
 {
-    ctx->add(testArgArgvIsNullPtr);
-    ctx->add(testArgCountEmptyArgv);
-    ctx->add(testArgCountZeroArgc);
-    ctx->add(testArgcBiggerSizeOfArgv);
-    ctx->add(testArgCountNonEmptyArgv);
-    ctx->add(testErrorCode);
+    ctx->add(testArgvIsEmpty);
+    ctx->add(testArgcExceedsArgv);
+    ctx->add(testValueErrors);
+    ctx->add(testMissingValue);
+    ctx->add(testFinishParse);
+    ctx->add(testSuggestions);
+    ctx->add(testTemporarySpecs);
+    ctx->add(testErrorCapacity);
 }
 
 } // namespace testargparse
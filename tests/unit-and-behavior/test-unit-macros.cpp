@@ -0,0 +1,482 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.hpp"
+
+#include "alloc-counter.h"
+#include "arg-parser.h"
+#include "test-defs.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace testargparse {
+namespace {
+
+TestContext::Return testParseFlag(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--size=4"), TAP_CHARS("-n"), TAP_CHARS("joe"), TAP_CHARS("-e"), TAP_CHARS("-r") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+
+    if (TAP_CHECK(ctx, PARSE_FLAG("-s, --size SIZE", 0, "") != 4))
+        return TAP_FAIL(ctx, "Wrong value joined with '='.");
+    if (TAP_CHECK(ctx, PARSE_FLAG("-n, --name NAME", std::string(), "") != "joe"))
+        return TAP_FAIL(ctx, "Wrong value of the next token.");
+    if (TAP_CHECK(ctx, !PARSE_FLAG("-e, --enable", false, "") || PARSE_FLAG("-d, --disable", true, "") != true))
+        return TAP_FAIL(ctx, "A bool flag has to toggle its default if it is given.");
+    if (TAP_CHECK(ctx, PARSE_FLAG("-r, --ratio RATIO", 0.5, "") != 0.5))
+        return TAP_FAIL(ctx, "The default has to be kept without a value.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT() != 1))
+        return TAP_FAIL(ctx, "The flag without value has to be unparsed.");
+
+    return TAP_PASS(ctx, "Parse flags with PARSE_FLAG.");
+}
+
+TestContext::Return testParseArg(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("first"), TAP_CHARS("-s"), TAP_CHARS("4"), TAP_CHARS("2") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-s, --size SIZE", 0, "");
+
+    if (TAP_CHECK(ctx, PARSE_ARG(std::string()) != "first"))
+        return TAP_FAIL(ctx, "Wrong first argument.");
+    if (TAP_CHECK(ctx, PARSE_ARG(0) != 2))
+        return TAP_FAIL(ctx, "The used tokens have to be skipped.");
+    if (TAP_CHECK(ctx, PARSE_ARG(7) != 7 || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "The default has to be kept without arguments.");
+
+    return TAP_PASS(ctx, "Parse arguments with PARSE_ARG.");
+}
+
+struct BoundOptions {
+    int size = 300;
+    double ratio = 0.5;
+    bool enable = false;
+    std::string path = "./build";
+    std::vector<std::string> includes;
+    std::string name = "none";
+};
+
+TestContext::Return testBindFlag(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--path=/a/path/longer/than/the/small/string"), TAP_CHARS("-e"),
+        TAP_CHARS("-I"), TAP_CHARS("a"), TAP_CHARS("-I"), TAP_CHARS("b"), TAP_CHARS("-r"), TAP_CHARS("x"), TAP_CHARS("joe") };
+    BoundOptions options;
+    options.path.reserve(64);
+    options.includes.reserve(2);
+    size_t allocs = 0;
+    for (int run = 0; run < 2; ++run) {
+        const apbench::AllocCounts begin = apbench::allocCounts();
+        PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+        const bool given = BIND_FLAG("-s, --size SIZE", &options.size, "") || !BIND_FLAG("-p, --path PATH", &options.path, "");
+        if (TAP_CHECK(ctx, given || BIND_FLAG_ALL("-I DIR", &options.includes, "") != 2))
+            return TAP_FAIL(ctx, "Wrong result of a bound flag.");
+        if (TAP_CHECK(ctx, !BIND_FLAG("-e, --enable", &options.enable, "") || !BIND_FLAG("-r, --ratio RATIO", &options.ratio, "")))
+            return TAP_FAIL(ctx, "A given flag has to be reported.");
+        if (TAP_CHECK(ctx, !BIND_ARG(&options.name) || BIND_ARG(&options.size)))
+            return TAP_FAIL(ctx, "Wrong result of a bound argument.");
+        allocs = apbench::allocCountsSince(begin).allocs;
+        options.enable = false;
+    }
+
+    if (TAP_CHECK(ctx, options.size != 300 || options.ratio != 0.5 || options.path != "/a/path/longer/than/the/small/string"))
+        return TAP_FAIL(ctx, "The members have to keep their initializers unless a valid value is given.");
+    if (TAP_CHECK(ctx, options.includes.size() != 2 || options.includes[1] != "b" || options.name != "joe" || ERROR_COUNT() != 1))
+        return TAP_FAIL(ctx, "Wrong bound values.");
+    if (TAP_CHECK(ctx, allocs))
+        return TAP_FAIL(ctx, "Binding into reserved members allocated " + std::to_string(allocs) + " times.");
+
+    char* help[] = { TAP_CHARS("prog"), TAP_CHARS("-h") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(help), help);
+    BIND_FLAG("-p, --path PATH", &options.path, "set path. Default is '%d'.");
+    std::string page;
+    ap::take_help_page(page);
+    if (TAP_CHECK(ctx, page.find("Default is '/a/path/longer/than/the/small/string'.") == std::string::npos))
+        return TAP_FAIL(ctx, "The help has to show the value of the member as the default.");
+
+    return TAP_PASS(ctx, "Bind flags and arguments to members.");
+}
+
+TestContext::Return testCheckFlag(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--verbose"), TAP_CHARS("-vv") };
+
+    if (TAP_CHECK(ctx, !CHECK_FLAG("-v, --verbose", TAP_ARRAY_SIZE(argv), argv)))
+        return TAP_FAIL(ctx, "The flag is not found.");
+    if (TAP_CHECK(ctx, CHECK_FLAG("-v, -q", TAP_ARRAY_SIZE(argv), argv)))
+        return TAP_FAIL(ctx, "A prefix of a token is not the flag.");
+
+    return TAP_PASS(ctx, "Check flags with CHECK_FLAG.");
+}
+
+TestContext::Return testBootstrapFlags(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--config"), TAP_CHARS("a.cfg"), TAP_CHARS("-x"), TAP_CHARS("5"), TAP_CHARS("--help") };
+    const bool help = PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    if (TAP_CHECK(ctx, !help || PARSE_BOOTSTRAP_FLAG("-c, --config FILE", std::string(), "") != "a.cfg"))
+        return TAP_FAIL(ctx, "A bootstrap flag has to be parsed even with the help.");
+    std::string page;
+    ap::take_help_page(page);
+    if (TAP_CHECK(ctx, page.find("--config FILE") == std::string::npos))
+        return TAP_FAIL(ctx, "A bootstrap flag has to be on the help page.");
+
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv) - 1, argv);
+    PARSE_BOOTSTRAP_FLAG("-c, --config FILE", std::string(), "");
+    if (TAP_CHECK(ctx, !HAS_FLAG("-x") || HAS_FLAG("--config") || HAS_FLAG("-y")))
+        return TAP_FAIL(ctx, "HAS_FLAG has to find only the given and not parsed flags.");
+    if (TAP_CHECK(ctx, PARSE_FLAG("-x X", 0, "") != 5 || HAS_FLAG("-x") || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "The second phase has to parse the rest of the tokens.");
+
+    return TAP_PASS(ctx, "Parse the bootstrap flags first, then the others.");
+}
+
+TestContext::Return testRepeatedTokens(TestContext* ctx)
+{
+    std::vector<std::string> storage(1, "prog");
+    for (int i = 0; i < 100; ++i) {
+        storage.push_back(i % 2 ? "-b" : "-a");
+        storage.push_back(std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for (size_t i = 0; i < storage.size(); ++i)
+        argv.push_back(storage[i].c_str());
+    PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+
+    int sum = 0;
+    for (int i = 0; i < 50; ++i)
+        sum += PARSE_FLAG("-b B", -1000, "") - PARSE_FLAG("-a A", -1000, "");
+    if (TAP_CHECK(ctx, sum != 50 || PARSE_FLAG("-a A", -1, "") != -1 || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "Every occurrence of a flag has to be parsed in order.");
+
+    return TAP_PASS(ctx, "Parse the repeated flags of a long argv in order.");
+}
+
+TestContext::Return testRepeatableFlags(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("-I"), TAP_CHARS("a"), TAP_CHARS("-v"), TAP_CHARS("--include=b"), TAP_CHARS("-O"), TAP_CHARS("1"),
+        TAP_CHARS("file"), TAP_CHARS("-v"), TAP_CHARS("-I"), TAP_CHARS("c"), TAP_CHARS("-O"), TAP_CHARS("3"), TAP_CHARS("-v") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    const std::vector<std::string> includes = PARSE_FLAG_ALL("-I, --include DIR", std::vector<std::string>(), "");
+    const std::vector<int> defines = PARSE_FLAG_ALL("-D NAME", std::vector<int>(1, 7), "");
+    const int level = PARSE_FLAG_LAST("-O LEVEL", 0, "");
+    const size_t verbosity = COUNT_FLAG("-v", "");
+
+    if (TAP_CHECK(ctx, includes.size() != 3 || includes[0] != "a" || includes[1] != "b" || includes[2] != "c"))
+        return TAP_FAIL(ctx, "Every value of a repeated flag has to be collected in order.");
+    if (TAP_CHECK(ctx, defines.size() != 1 || defines[0] != 7))
+        return TAP_FAIL(ctx, "The default has to be kept without occurrences.");
+    if (TAP_CHECK(ctx, level != 3 || verbosity != 3))
+        return TAP_FAIL(ctx, "Wrong last value or count of a repeated flag.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT() != 1 || PARSE_ARG(std::string()) != "file"))
+        return TAP_FAIL(ctx, "Only the argument has to be left.");
+
+    return TAP_PASS(ctx, "Collect the repeated flags.");
+}
+
+TestContext::Return testRepeatableContainers(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("-b"), TAP_CHARS("1"), TAP_CHARS("-n"), TAP_CHARS("4"), TAP_CHARS("-b"), TAP_CHARS("0"),
+        TAP_CHARS("-n"), TAP_CHARS("x"), TAP_CHARS("-n"), TAP_CHARS("6"), TAP_CHARS("-d"), TAP_CHARS("y"), TAP_CHARS("-c"), TAP_CHARS("a") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    const std::vector<bool> bits = PARSE_FLAG_ALL("-b BIT", std::vector<bool>(), "");
+    const std::list<int> numbers = PARSE_FLAG_ALL("-n NUMBER", std::list<int>(1, 7), "");
+    const std::deque<double> defaults = PARSE_FLAG_ALL("-d DOUBLE", std::deque<double>(1, 0.5), "");
+    const std::string chars = PARSE_FLAG_ALL("-c CHAR", std::string("z"), "");
+
+    if (TAP_CHECK(ctx, bits.size() != 2 || !bits[0] || bits[1] || chars != "a"))
+        return TAP_FAIL(ctx, "Wrong values of a std::vector<bool> or a std::string.");
+    if (TAP_CHECK(ctx, numbers != std::list<int>({ 4, 6 }) || ERROR_COUNT() != 2))
+        return TAP_FAIL(ctx, "An invalid value has to be skipped with an error.");
+    if (TAP_CHECK(ctx, defaults.size() != 1 || defaults[0] != 0.5))
+        return TAP_FAIL(ctx, "The default has to be kept without valid values.");
+
+    char* help[] = { TAP_CHARS("prog"), TAP_CHARS("-h") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(help), help);
+    PARSE_FLAG_ALL("-b BIT", std::vector<bool>(2, true), "set bits. Default is '%d'.");
+    std::string page;
+    ap::take_help_page(page);
+    if (TAP_CHECK(ctx, page.find("Default is '1, 1'.") == std::string::npos))
+        return TAP_FAIL(ctx, "Wrong default of a std::vector<bool>:\n" + page);
+
+    return TAP_PASS(ctx, "Collect the repeated flags into the sequence containers.");
+}
+
+TestContext::Return testRepeatableViews(TestContext* ctx)
+{
+    std::vector<std::string> storage(1, "prog");
+    for (int i = 0; i < 100; ++i) {
+        storage.push_back("-D");
+        storage.push_back("NAME_" + std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for (size_t i = 0; i < storage.size(); ++i)
+        argv.push_back(storage[i].c_str());
+    PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+    const std::vector<ap::StringRef> defines = PARSE_FLAG_ALL("-D NAME", std::vector<ap::StringRef>(), "");
+
+    if (TAP_CHECK(ctx, defines.size() != 100 || defines[42].data != argv[2 * 42 + 2] || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "The views have to point to the arguments in argv.");
+
+    return TAP_PASS(ctx, "Collect the repeated flags of a long argv as views.");
+}
+
+/*! \brief Bundle the short flags in a test, 's_short_flag_prefixes' is shared by the threads */
+struct ShortFlagPrefixes {
+    explicit ShortFlagPrefixes(const char* prefixes) : saved(ap::s_short_flag_prefixes) { ap::s_short_flag_prefixes = prefixes; }
+    ~ShortFlagPrefixes() { ap::s_short_flag_prefixes = saved; }
+    const char* saved;
+};
+
+TestContext::Return testBundledShortFlags(TestContext* ctx)
+{
+    const ShortFlagPrefixes prefixes("-+");
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("-xvf"), TAP_CHARS("out.tar"), TAP_CHARS("+q"), TAP_CHARS("-vv"),
+        TAP_CHARS("-5"), TAP_CHARS("--long"), TAP_CHARS("-o"), TAP_CHARS("-xy"), TAP_CHARS("-ab=c") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    const bool x = PARSE_FLAG("-x", false, "");
+    const size_t verbosity = COUNT_FLAG("-v, --verbose", "");
+    const std::string file = PARSE_FLAG("-f FILE", std::string(), "");
+    const bool quiet = PARSE_FLAG("+q", false, "");
+    const bool isLong = PARSE_FLAG("--long", false, "");
+    const std::string other = PARSE_FLAG("-o VALUE", std::string(), "");
+    const bool a = PARSE_FLAG("-a", false, "");
+    const std::string b = PARSE_FLAG("-b VALUE", std::string(), "");
+
+    if (TAP_CHECK(ctx, !x || verbosity != 3 || file != "out.tar"))
+        return TAP_FAIL(ctx, "Wrong flags of the bundles.");
+    if (TAP_CHECK(ctx, !quiet || !isLong))
+        return TAP_FAIL(ctx, "The short flag of the '+' prefix and the long flags are not bundles.");
+    if (TAP_CHECK(ctx, other != "-xy"))
+        return TAP_FAIL(ctx, "A bundle as a value has to be the whole argument, not '" + other + "'.");
+    if (TAP_CHECK(ctx, !a || b != "c"))
+        return TAP_FAIL(ctx, "Wrong bundle with a joined value.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT() != 1 || PARSE_ARG(0) != -5))
+        return TAP_FAIL(ctx, "A negative number is not a bundle.");
+
+    char* valueArgv[] = { TAP_CHARS("prog"), TAP_CHARS("-fx"), TAP_CHARS("out.tar") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(valueArgv), valueArgv);
+    if (TAP_CHECK(ctx, PARSE_FLAG("-f FILE", std::string("none"), "") != "none" || !PARSE_FLAG("-x", false, "")))
+        return TAP_FAIL(ctx, "Only the last flag of a bundle can have a value.");
+
+    return TAP_PASS(ctx, "Parse the bundles of short flags.");
+}
+
+TestContext::Return testManyBundles(TestContext* ctx)
+{
+    const ShortFlagPrefixes prefixes("-");
+    std::vector<const char*> argv(1, "prog");
+    for (int i = 0; i < 100; ++i)
+        argv.push_back(i % 2 ? "-ab" : "-ba");
+    argv.push_back("-c");
+    argv.push_back("value");
+    PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data());
+
+    if (TAP_CHECK(ctx, COUNT_FLAG("-a", "") != 100 || COUNT_FLAG("-b", "") != 100 || PARSE_FLAG("-c C", std::string(), "") != "value"))
+        return TAP_FAIL(ctx, "Wrong flags of the indexed bundles.");
+    if (TAP_CHECK(ctx, UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "Every bundle has to be parsed.");
+
+    return TAP_PASS(ctx, "Parse many bundles of short flags.");
+}
+
+/*! \brief Parse the flags of every kind and the positional arguments, the results are returned as a text */
+std::string parseLine(bool help)
+{
+    std::string result = help ? "help" : "";
+    result += " mode=" + PARSE_FLAG("-m, --mode MODE", std::string("none"), "");
+    result += " verbose=" + std::to_string(PARSE_FLAG("-v, --verbose", false, ""));
+    result += " quiet=" + std::to_string(COUNT_FLAG("-q", ""));
+    result += " n=" + std::to_string(PARSE_FLAG("-n N", 0, ""));
+    const std::vector<std::string> includes = PARSE_FLAG_ALL("-I DIR", std::vector<std::string>(), "");
+    for (size_t i = 0; i < includes.size(); ++i)
+        result += " I=" + includes[i];
+    while (UNPARSED_COUNT())
+        result += " " + PARSE_ARG(std::string("?"));
+    return result;
+}
+
+TestContext::Return testEditedLine(TestContext* ctx)
+{
+    const ShortFlagPrefixes prefixes("-");
+    const char* pool[] = { "-m", "fast", "--mode=slow", "-v", "-vq", "-I", "dir", "-I=inc", "-q", "-n", "7", "file", "--help=1", "-qvn", "-vh", "--" };
+    std::list<std::string> words(1, "prog");
+    std::vector<std::vector<std::string> > lines;
+    std::vector<std::string> results;
+    unsigned long long random = 1;
+    for (int step = 0; step < 400; ++step) {
+        random = random * 6364136223846793005ull + 1442695040888963407ull;
+        const size_t first = 1 + size_t(random >> 8) % words.size();
+        const size_t removed = size_t(random >> 16) % std::min<size_t>(4, words.size() - first + 1);
+        std::list<std::string>::iterator word = words.begin();
+        std::advance(word, first);
+        for (size_t i = 0; i < removed; ++i)
+            word = words.erase(word);
+        for (size_t i = size_t(random >> 24) % 4; i; --i)
+            words.insert(word, pool[size_t(random >> (28 + 4 * i)) % TAP_ARRAY_SIZE(pool)]);
+
+        std::vector<const char*> argv;
+        for (word = words.begin(); word != words.end(); ++word)
+            argv.push_back(word->c_str());
+        results.push_back(parseLine(PARSE_EDIT("-h, --help", "", "", int(argv.size()), argv.data(), first, removed)));
+        lines.push_back(std::vector<std::string>(words.begin(), words.end()));
+    }
+
+    for (size_t step = 0; step < lines.size(); ++step) {
+        std::vector<const char*> argv;
+        for (size_t i = 0; i < lines[step].size(); ++i)
+            argv.push_back(lines[step][i].c_str());
+        if (TAP_CHECK(ctx, parseLine(PARSE_HELP("-h, --help", "", "", int(argv.size()), argv.data())) != results[step]))
+            return TAP_FAIL(ctx, "The edited line has to be parsed as the whole line, step: " + std::to_string(step));
+    }
+
+    return TAP_PASS(ctx, "Parse a line edited word by word.");
+}
+
+TestContext::Return testEditedHelp(TestContext* ctx)
+{
+    std::string words[] = { "prog", "-v", "--hel", "x" };
+    const char* argv[] = { words[0].c_str(), words[1].c_str(), words[2].c_str(), words[3].c_str() };
+    const bool first = PARSE_EDIT("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv, 1, 0);
+    PARSE_FLAG("-v, --verbose", false, "");
+
+    words[2] = "--help";
+    argv[2] = words[2].c_str();
+    const bool typed = PARSE_EDIT("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv, 2, 1);
+    PARSE_FLAG("-v, --verbose", false, "");
+    std::string page;
+    ap::take_help_page(page);
+
+    if (TAP_CHECK(ctx, first || !typed || page.find("--verbose") == std::string::npos))
+        return TAP_FAIL(ctx, "The help flag has to be found after the edit.");
+    if (TAP_CHECK(ctx, PARSE_EDIT("-h, --help", "", "", 2, argv, 2, 2)))
+        return TAP_FAIL(ctx, "The help flag has to be lost with the removed words.");
+    if (TAP_CHECK(ctx, PARSE_FLAG("-v, --verbose", false, "") != true || UNPARSED_COUNT()))
+        return TAP_FAIL(ctx, "Wrong parse after removing the last words.");
+
+    return TAP_PASS(ctx, "Find the help flag in an edited line.");
+}
+
+/*! \brief A program which defines only flags, it never flushes its help page */
+void helpOnlyProgram(int argc, char* argv[])
+{
+    PARSE_HELP("-h, --help", "show this help.", "Usage: %p [options]", argc, argv);
+    PARSE_FLAG("-s, --size SIZE", 300, "set size. Default is '%d'.");
+}
+
+void appendPage(void* context, const char* data, size_t size)
+{
+    static_cast<std::string*>(context)->append(data, size);
+}
+
+TestContext::Return testHelpOnlyProgram(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--help") };
+    std::string page;
+    const ap::Writer stdoutWriter = ap::s_stdout;
+    const ap::Writer pageWriter = { appendPage, &page };
+    ap::s_stdout = pageWriter;
+    helpOnlyProgram(TAP_ARRAY_SIZE(argv), argv);
+    ap::s_stdout = stdoutWriter;
+    if (TAP_CHECK(ctx, !page.empty()))
+        return TAP_FAIL(ctx, "The page must not be written before the definitions end.");
+    PARSE_HELP("-h, --help", "", "", 1, argv);
+    if (TAP_CHECK(ctx, page.find("Usage: prog [options]") || page.find("--size SIZE") == std::string::npos))
+        return TAP_FAIL(ctx, "The next parse has to print the page to the output of its program:\n" + page);
+
+    // The last page of a process is printed at exit.
+    int fds[2];
+    if (pipe(fds))
+        return TAP_NOT_TESTED(ctx, "No pipe for the output of the child process.");
+    std::fflush(stdout);
+    const pid_t pid = fork();
+    if (!pid) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        helpOnlyProgram(TAP_ARRAY_SIZE(argv), argv);
+        std::exit(0);
+    }
+    close(fds[1]);
+    std::string output;
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(fds[0], buffer, sizeof(buffer))) > 0)
+        output.append(buffer, size);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (TAP_CHECK(ctx, output != page || !WIFEXITED(status) || WEXITSTATUS(status)))
+        return TAP_FAIL(ctx, "The page has to be printed at exit:\n" + output);
+
+    return TAP_PASS(ctx, "Print the help page of a program which has only flags.");
+}
+
+TestContext::Return testParseWithoutAllocations(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--size=4"), TAP_CHARS("-r"), TAP_CHARS("0.25"), TAP_CHARS("-e"), TAP_CHARS("arg") };
+    size_t allocs = 0;
+    for (int run = 0; run < 2; ++run) {
+        const apbench::AllocCounts begin = apbench::allocCounts();
+        PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+        PARSE_FLAG("-s, --size SIZE", 0, "");
+        PARSE_FLAG("-r, --ratio RATIO", 0.5, "");
+        PARSE_FLAG("-e, --enable", false, "");
+        PARSE_ARG(0);
+        allocs = apbench::allocCountsSince(begin).allocs;
+    }
+
+    if (TAP_CHECK(ctx, allocs))
+        return TAP_FAIL(ctx, "A parse of numbers allocated " + std::to_string(allocs) + " times.");
+
+    return TAP_PASS(ctx, "A repeated parse of numbers does not allocate.");
+}
+
+} // namespace anonymous
+
+void unitMacrosTests(TestContext* ctx)
+{
+    ctx->add(testParseFlag);
+    ctx->add(testParseArg);
+    ctx->add(testBindFlag);
+    ctx->add(testCheckFlag);
+    ctx->add(testBootstrapFlags);
+    ctx->add(testRepeatedTokens);
+    ctx->add(testRepeatableFlags);
+    ctx->add(testRepeatableContainers);
+    ctx->add(testRepeatableViews);
+    ctx->add(testBundledShortFlags, TestContext::Serial);
+    ctx->add(testManyBundles, TestContext::Serial);
+    ctx->add(testEditedLine, TestContext::Serial);
+    ctx->add(testEditedHelp);
+    ctx->add(testHelpOnlyProgram, TestContext::Serial);
+    ctx->add(testParseWithoutAllocations);
+}
+
+} // namespace testargparse
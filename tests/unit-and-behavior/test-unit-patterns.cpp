@@ -0,0 +1,124 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+
+namespace testargparse {
+namespace {
+
+void setProgramName(const char* name)
+{
+    char* argv[] = { TAP_CHARS(name) };
+    PARSE_HELP("--help", "", "", TAP_ARRAY_SIZE(argv), argv);
+}
+
+TestContext::Return testPatterns(TestContext* ctx)
+{
+    setProgramName("prog");
+
+    struct {
+        const std::string str;
+        const std::string def;
+        const std::string expected;
+    } testCases[] = {
+        { "", "1", "" },
+        { "no pattern", "1", "no pattern" },
+        { "%p", "1", "prog" },
+        { "%d", "1", "1" },
+        { "Usage: %p [%d] %p", "x", "Usage: prog [x] prog" },
+        { "%", "1", "%" },
+        { "100%", "1", "100%" },
+        { "%%d", "1", "%1" },
+        { "%x%d", "1", "%x1" },
+        { "%d%d%d", "ab", "ababab" },
+    };
+
+    for (size_t testCase = 0; testCase < TAP_ARRAY_SIZE(testCases); ++testCase) {
+        const std::string result = ap::expand_patterns(testCases[testCase].str, testCases[testCase].def);
+        if (TAP_CHECK(ctx, result != testCases[testCase].expected))
+            return TAP_FAIL(ctx, TAP_CASE_NAME(testCase, testCases[testCase].str) + "Wrong expansion: '" + result + "'.");
+    }
+
+    return TAP_PASS(ctx, "Expand '%p' and '%d' patterns.");
+}
+
+TestContext::Return testAdversarialDefaults(TestContext* ctx)
+{
+    setProgramName("%d%p");
+
+    struct {
+        const std::string str;
+        const std::string def;
+        const std::string expected;
+    } testCases[] = {
+        { "%d", "%d", "%d" },
+        { "[%d]", "%d%d", "[%d%d]" },
+        { "%p", "1", "%d%p" },
+        { "%p %d", "%p", "%d%p %p" },
+        { "%d", "%", "%" },
+        { "%d%d", "%", "%%" },
+        { "%d", "%%dd", "%%dd" },
+    };
+
+    for (size_t testCase = 0; testCase < TAP_ARRAY_SIZE(testCases); ++testCase) {
+        const std::string result = ap::expand_patterns(testCases[testCase].str, testCases[testCase].def);
+        if (TAP_CHECK(ctx, result != testCases[testCase].expected))
+            return TAP_FAIL(ctx, TAP_CASE_NAME(testCase, testCases[testCase].str) + "Wrong expansion: '" + result + "'.");
+    }
+
+    return TAP_PASS(ctx, "Substituted values are not expanded again.");
+}
+
+TestContext::Return testLongTemplate(TestContext* ctx)
+{
+    setProgramName("prog");
+
+    const size_t count = 100000;
+    std::string str;
+    std::string expected;
+    for (size_t i = 0; i < count; ++i) {
+        str += "%d ";
+        expected += "%d%d ";
+    }
+
+    if (TAP_CHECK(ctx, ap::expand_patterns(str, "%d%d") != expected))
+        return TAP_FAIL(ctx, "Wrong expansion of a long template!");
+
+    return TAP_PASS(ctx, "Expand a template with many patterns.");
+}
+
+} // namespace anonymous
+
+void unitPatternsTests(TestContext* ctx)
+{
+    ctx->add(testPatterns);
+    ctx->add(testAdversarialDefaults);
+    ctx->add(testLongTemplate);
+}
+
+} // namespace testargparse
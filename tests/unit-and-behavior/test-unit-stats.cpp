@@ -0,0 +1,105 @@
+/* Copyright (C) 2016, Szilard Ledan <szledan@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "test.hpp"
+
+#include "arg-parser.h"
+#include "test-defs.hpp"
+
+namespace testargparse {
+namespace {
+
+#if defined(AP_STATS)
+
+#define TAP_CHECK_STAT(CTX, STATS, COUNTER, EXPECTED) do { \
+        if (TAP_CHECK(CTX, STATS.COUNTER != EXPECTED)) \
+            return TAP_FAIL(CTX, std::string("Wrong " #COUNTER ": ") + std::to_string(STATS.COUNTER) + " instead of " #EXPECTED "."); \
+    } while (false)
+
+TestContext::Return testParseStats(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--size=4"), TAP_CHARS("-e"), TAP_CHARS("first"), TAP_CHARS("second") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-s, --size SIZE", 0, "");
+    PARSE_FLAG("-e, --enable", false, "");
+    PARSE_FLAG("-m, --missing", 1, "");
+    PARSE_ARG(std::string());
+
+    const ap::Stats stats = PARSE_STATS();
+    TAP_CHECK_STAT(ctx, stats, tokens, 5u);
+    TAP_CHECK_STAT(ctx, stats, definedFlags, 4u);
+    TAP_CHECK_STAT(ctx, stats, parsedFlags, 2u);
+    TAP_CHECK_STAT(ctx, stats, definedArgs, 1u);
+    TAP_CHECK_STAT(ctx, stats, parsedArgs, 1u);
+    TAP_CHECK_STAT(ctx, stats, conversions, 2u);
+    TAP_CHECK_STAT(ctx, stats, unknownTokens, 1u);
+    if (TAP_CHECK(ctx, stats.comparisons < stats.tokensScanned))
+        return TAP_FAIL(ctx, "Less comparisons than scanned tokens.");
+
+    return TAP_PASS(ctx, "Count the flags, arguments and conversions of a parse.");
+}
+
+TestContext::Return testHelpStats(TestContext* ctx)
+{
+    char* argv[] = { TAP_CHARS("prog"), TAP_CHARS("--help") };
+    PARSE_HELP("-h, --help", "", "", TAP_ARRAY_SIZE(argv), argv);
+    PARSE_FLAG("-s, --size SIZE", 0, "");
+    PARSE_FLAG("-e, --enable", false, "");
+    std::string page;
+    ap::take_help_page(page);
+
+    const ap::Stats stats = PARSE_STATS();
+    TAP_CHECK_STAT(ctx, stats, definedFlags, 3u);
+    TAP_CHECK_STAT(ctx, stats, parsedFlags, 1u);
+    TAP_CHECK_STAT(ctx, stats, conversions, 0u);
+    if (TAP_CHECK(ctx, stats.helpSeconds <= 0.0))
+        return TAP_FAIL(ctx, "No time spent on the help page.");
+
+    return TAP_PASS(ctx, "Count the flags of the help page.");
+}
+
+#undef TAP_CHECK_STAT
+
+#else // !defined(AP_STATS)
+
+TestContext::Return testParseStats(TestContext* ctx)
+{
+    return TAP_NOT_TESTED(ctx, "The parser is built without AP_STATS.");
+}
+
+#endif // defined(AP_STATS)
+
+} // namespace anonymous
+
+void unitStatsTests(TestContext* ctx)
+{
+    ctx->add(testParseStats);
+#if defined(AP_STATS)
+    ctx->add(testHelpStats);
+#endif // defined(AP_STATS)
+}
+
+} // namespace testargparse
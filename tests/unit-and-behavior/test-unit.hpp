@@ -27,19 +27,28 @@
 
 #include "test.hpp"
 
-#include "arg-parse.hpp"
 #include "test-defs.hpp"
 #include <string>
 
 namespace testargparse {
 
+// Tests of the current macro API, see tests/CMakeLists.txt.
+void unitCommandsTests(TestContext*);
+void unitCompletionTests(TestContext*);
+void unitConfigTests(TestContext*);
+void unitDeclaredOptionsTests(TestContext*);
+void unitErrorsTests(TestContext*);
+void unitMacrosTests(TestContext*);
+void unitPatternsTests(TestContext*);
+void unitStatsTests(TestContext*);
+
+// Tests of the former argparse::ArgParse API, not built.
 void unitArgStructTests(TestContext*);
 void unitCheckAndReadTests(TestContext*);
 void unitCheckTests(TestContext*);
 void unitConstructorsTests(TestContext*);
 void unitCountsTests(TestContext*);
 void unitDefTests(TestContext*);
-void unitErrorsTests(TestContext*);
 void unitFlagStructTests(TestContext*);
 void unitOperatorTests(TestContext*);
 void unitOptionsTests(TestContext*);